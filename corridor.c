@@ -0,0 +1,340 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+/* corridor contracted graph of a maze, for repeated solving */
+
+#include <stdlib.h>
+
+#include "grid.h"
+#include "distance.h"
+#include "corridor.h"
+
+#define CG_FAR	0x7fffffff	/* not reached */
+
+/* connections a cell has */
+static int
+degree(GRID *g, int id)
+{
+  int n = 0;
+
+  for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+    if(linkbyid(g, id, go) != NC) { n ++; }
+  }
+  return n;
+} /* degree() */
+
+/* the connection of a two connection cell that isn't prev */
+static int
+otherlink(GRID *g, int id, int prev)
+{
+  int n;
+
+  for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+    n = linkbyid(g, id, go);
+    if((n != NC) && (n != prev)) { return n; }
+  }
+  return NC;
+} /* otherlink() */
+
+/* Walk from a node through first until the next node, returning the
+ * cell id of that node, with the steps taken in *steps. If e is not
+ * NC, corridor cells not yet claimed get e and their offset.
+ */
+static int
+walkcorridor(CGRAPH *cg, int from, int first, int e, int *steps)
+{
+  int prev = from, cur = first, next, k = 1;
+
+  while(cg->nodeof[cur] == NC) {
+    if((e != NC) && (cg->edgeof[cur] == NC)) {
+      cg->edgeof[cur] = e;
+      cg->offset[cur] = k;
+    }
+    next = otherlink(cg->grid, cur, prev);
+    prev = cur;
+    cur = next;
+    k ++;
+  }
+  *steps = k;
+  return cur;
+} /* walkcorridor() */
+
+CGRAPH *
+createcorridors(GRID *g)
+{
+  CGRAPH *cg;
+  int id, n, e, d, steps;
+
+  if(!g) { return NULL; }
+
+  cg = (CGRAPH *)calloc( 1, sizeof(CGRAPH) );
+  if(!cg) { return NULL; }
+
+  cg->grid = g;
+  cg->msize = g->max;
+  cg->nodeof = malloc( g->max * sizeof(int) );
+  cg->edgeof = malloc( g->max * sizeof(int) );
+  cg->offset = malloc( g->max * sizeof(int) );
+  if(!cg->nodeof || !cg->edgeof || !cg->offset) {
+    freecorridors(cg);
+    return NULL;
+  }
+
+  syncgrid(g);
+
+  /* nodes: anything but two connections */
+  cg->nodes = cg->ends = 0;
+  for(id = 0; id < g->max; id ++) {
+    d = degree(g, id);
+    cg->nodeof[id] = (d == 2) ? NC : cg->nodes ++;
+    cg->edgeof[id] = NC;
+    cg->ends += d;
+  }
+
+  /* claim corridor cells from the nodes; any left after that are in
+   * loops of nothing but corridor, and one cell of each becomes a node
+   */
+  for(id = 0; id < g->max; id ++) {
+    if(cg->nodeof[id] == NC) { continue; }
+    for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+      n = linkbyid(g, id, go);
+      if(n != NC) { walkcorridor(cg, id, n, 0, &steps); }
+    }
+  }
+  for(id = 0; id < g->max; id ++) {
+    if((cg->nodeof[id] != NC) || (cg->edgeof[id] != NC)) { continue; }
+    cg->nodeof[id] = cg->nodes ++;
+    for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+      n = linkbyid(g, id, go);
+      if(n != NC) { walkcorridor(cg, id, n, 0, &steps); }
+    }
+  }
+
+  cg->node = malloc( cg->nodes * sizeof(int) );
+  cg->first = malloc( (cg->nodes + 1) * sizeof(int) );
+  cg->owner = malloc( cg->ends * sizeof(int) );
+  cg->to = malloc( cg->ends * sizeof(int) );
+  cg->weight = malloc( cg->ends * sizeof(int) );
+  cg->via = malloc( cg->ends * sizeof(int) );
+  cg->dist = malloc( cg->nodes * sizeof(int) );
+  cg->pnode = malloc( cg->nodes * sizeof(int) );
+  cg->stamp = calloc( cg->nodes, sizeof(int) );
+  cg->heapf = malloc( (cg->ends + 2) * sizeof(int) );
+  cg->heapn = malloc( (cg->ends + 2) * sizeof(int) );
+  if(!cg->node || !cg->first || !cg->owner || !cg->to || !cg->weight ||
+     !cg->via || !cg->dist || !cg->pnode || !cg->stamp || !cg->heapf ||
+     !cg->heapn) {
+    freecorridors(cg);
+    return NULL;
+  }
+
+  /* now the edges for real, and each corridor cell's place on one */
+  for(id = 0; id < g->max; id ++) {
+    cg->edgeof[id] = NC;
+    if(cg->nodeof[id] != NC) { cg->node[cg->nodeof[id]] = id; }
+  }
+  e = 0;
+  for(n = 0; n < cg->nodes; n ++) {
+    cg->first[n] = e;
+    id = cg->node[n];
+    for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+      d = linkbyid(g, id, go);
+      if(d == NC) { continue; }
+      cg->owner[e] = n;
+      cg->via[e] = d;
+      cg->to[e] = cg->nodeof[walkcorridor(cg, id, d, e, &steps)];
+      cg->weight[e] = steps;
+      e ++;
+    }
+  }
+  cg->first[cg->nodes] = e;
+  cg->query = 0;
+  cg->popped = 0;
+
+  return cg;
+} /* createcorridors() */
+
+void
+freecorridors(CGRAPH *cg)
+{
+  if(!cg) { return; }
+  if(cg->node) { free(cg->node); }
+  if(cg->nodeof) { free(cg->nodeof); }
+  if(cg->first) { free(cg->first); }
+  if(cg->owner) { free(cg->owner); }
+  if(cg->to) { free(cg->to); }
+  if(cg->weight) { free(cg->weight); }
+  if(cg->via) { free(cg->via); }
+  if(cg->edgeof) { free(cg->edgeof); }
+  if(cg->offset) { free(cg->offset); }
+  if(cg->dist) { free(cg->dist); }
+  if(cg->pnode) { free(cg->pnode); }
+  if(cg->stamp) { free(cg->stamp); }
+  if(cg->heapf) { free(cg->heapf); }
+  if(cg->heapn) { free(cg->heapn); }
+  free(cg);
+} /* freecorridors() */
+
+/* Cells of an edge from offset lo to hi, offset 0 being its owner
+ * and weight its far end, into out; reversed if asked. Returns the
+ * number of cells.
+ */
+static int
+edgecells(CGRAPH *cg, int e, int lo, int hi, int *out, int reverse)
+{
+  int prev = NC, cur = cg->node[cg->owner[e]], next;
+
+  for(int k = 0; k <= hi; k ++) {
+    if(k >= lo) { out[reverse ? hi - k : k - lo] = cur; }
+    if(k == hi) { break; }
+    next = k ? otherlink(cg->grid, cur, prev) : cg->via[e];
+    prev = cur;
+    cur = next;
+  }
+  return hi - lo + 1;
+} /* edgecells() */
+
+/* give a node a distance, if it's better than what it has */
+static void
+reach(CGRAPH *cg, int *len, int n, int d, int from, int target)
+{
+  if((cg->stamp[n] == cg->query) && (cg->dist[n] <= d)) { return; }
+  cg->stamp[n] = cg->query;
+  cg->dist[n] = d;
+  cg->pnode[n] = from;
+  heappush(cg->heapf, cg->heapn, len,
+  	   d + manhattan(cg->grid, cg->node[n], target), n);
+} /* reach() */
+
+/* A* over nodes. The start and target may be corridor cells, which
+ * reach the nodes at each end of their corridor; both on the same
+ * corridor can also go straight along it. Edges are at least as long
+ * as the Manhattan distance between their ends, so the heuristic is
+ * consistent and a node's distance is final once it is popped.
+ */
+int
+corridorto(CGRAPH *cg, DMAP *dm, CELL *c)
+{
+  int src, dst, se, sk, te, tk, best, bestnode, bestend;
+  int len, n, m, e, d, pos, *path, *chain, nchain;
+
+  if(!cg || !dm || !c) { return DISTANCE_ERROR; }
+  if(dm->grid != cg->grid) { return DISTANCE_ERROR; }
+  if(dm->seen) { return DISTANCE_ERROR; }	/* compact maps */
+
+  src = dm->root_id;
+  dst = c->id;
+
+  if(src == dst) {
+    dm->map[dst] = 0;
+    dm->target_id = dst;
+    dm->frontier[0] = NV;
+    return 0;
+  }
+
+  cg->query ++;
+  cg->popped = 0;
+  len = 0;
+  best = CG_FAR;
+  bestnode = bestend = NC;
+
+  se = (cg->nodeof[src] == NC) ? cg->edgeof[src] : NC;
+  sk = (se == NC) ? 0 : cg->offset[src];
+  te = (cg->nodeof[dst] == NC) ? cg->edgeof[dst] : NC;
+  tk = (te == NC) ? 0 : cg->offset[dst];
+
+  if(se == NC) {
+    reach(cg, &len, cg->nodeof[src], 0, NC, dst);
+  } else {
+    reach(cg, &len, cg->owner[se], sk, NC, dst);
+    reach(cg, &len, cg->to[se], cg->weight[se] - sk, NC, dst);
+    if(se == te) {
+      best = (sk < tk) ? tk - sk : sk - tk;
+    }
+  }
+
+  while(len) {
+    if(cg->heapf[0] >= best) { break; }
+    n = heappop(cg->heapf, cg->heapn, &len);
+    cg->popped ++;
+    /* stale entry, or n already done */
+    if(cg->stamp[n] != cg->query) { continue; }
+    d = cg->dist[n];
+
+    if(te == NC) {
+      if(cg->node[n] == dst) { best = d; bestnode = n; break; }
+    } else {
+      if((n == cg->owner[te]) && (d + tk < best)) {
+        best = d + tk;
+	bestnode = n;
+	bestend = 0;
+      }
+      if((n == cg->to[te]) && (d + cg->weight[te] - tk < best)) {
+        best = d + cg->weight[te] - tk;
+	bestnode = n;
+	bestend = 1;
+      }
+    }
+
+    /* mark done without losing the distance */
+    cg->stamp[n] = -cg->query;
+    for(e = cg->first[n]; e < cg->first[n+1]; e ++) {
+      m = cg->to[e];
+      if(cg->stamp[m] == -cg->query) { continue; }
+      reach(cg, &len, m, d + cg->weight[e], e, dst);
+    }
+  }
+
+  if(best == CG_FAR) { return DISTANCE_ERROR; }
+
+  /* Lay the cells out start to target. pnode holds the edge each
+   * node was reached by, its owner being the node before.
+   */
+  path = dm->nextfrontier;
+  pos = 0;
+  if(bestnode == NC) {
+    /* straight along the shared corridor */
+    if(sk <= tk) {
+      edgecells(cg, se, sk, tk, path, 0);
+    } else {
+      edgecells(cg, se, tk, sk, path, 1);
+    }
+  } else {
+    /* nodes back to the start, in the frontier array for now */
+    chain = dm->frontier;
+    nchain = 0;
+    for(n = bestnode; ; n = cg->owner[cg->pnode[n]]) {
+      chain[nchain++] = n;
+      if(cg->pnode[n] == NC) { break; }
+    }
+
+    n = chain[nchain - 1];
+    if(se == NC) {
+      path[pos++] = src;
+    } else if((n == cg->owner[se]) && (cg->dist[n] == sk)) {
+      pos += edgecells(cg, se, 0, sk, path + pos, 1);
+    } else {
+      pos += edgecells(cg, se, sk, cg->weight[se], path + pos, 0);
+    }
+
+    for(int k = nchain - 2; k >= 0; k --) {
+      e = cg->pnode[chain[k]];
+      pos += edgecells(cg, e, 0, cg->weight[e], path + pos - 1, 0) - 1;
+    }
+
+    if(te != NC) {
+      if(bestend == 0) {
+	edgecells(cg, te, 0, tk, path + pos - 1, 0);
+      } else {
+	edgecells(cg, te, tk, cg->weight[te], path + pos - 1, 1);
+      }
+    }
+  }
+
+  for(int k = 0; k <= best; k ++) {
+    dm->map[path[k]] = k;
+    if(dm->parent && k) { dm->parent[path[k]] = path[k-1]; }
+  }
+  dm->target_id = dst;
+  dm->frontier[0] = NV;
+
+  return best;
+} /* corridorto() */
@@ -0,0 +1,52 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+/* corridor contracted graph of a maze, for repeated solving */
+
+#ifndef _CORRIDOR_H
+#define _CORRIDOR_H
+
+#include "grid.h"
+#include "distance.h"
+
+/* Most cells of a perfect maze have exactly two connections, and
+ * just lead from one cell to the next. Here every such chain is one
+ * weighted edge between nodes: junctions and dead ends (any cell
+ * without exactly two connections), plus one cell of each loop made
+ * only of two connection cells. Edges are stored once from each end,
+ * grouped by node. No part of this structure is intended to be
+ * changed by users.
+ */
+typedef struct {
+  GRID *grid;
+  int msize;		/* cells in the grid */
+  int nodes;		/* junctions, dead ends and loop cells */
+  int ends;		/* edges, counted from both ends */
+  int *node;		/* cell id of each node */
+  int *nodeof;		/* node of each cell, NC for corridor cells */
+  int *first;		/* edges of node n are first[n] to first[n+1] - 1 */
+  int *owner;		/* node each edge starts from */
+  int *to;		/* node each edge leads to */
+  int *weight;		/* steps along each edge */
+  int *via;		/* first cell along each edge */
+  int *edgeof;		/* for corridor cells, an edge they are on */
+  int *offset;		/* and how many steps from its owner */
+  /* per query work space */
+  int *dist;		/* steps from the start, valid if stamp matches */
+  int *pnode;		/* edge each was reached by, NC for start nodes */
+  int *stamp;		/* query each node was last reached in */
+  int *heapf;		/* priority queue keys */
+  int *heapn;		/* and nodes */
+  int query;		/* count of queries */
+  int popped;		/* nodes taken off the queue by the last query */
+} CGRAPH;
+
+/* build and free; the grid should not change in between */
+CGRAPH *createcorridors(GRID *);
+void freecorridors(CGRAPH *);
+
+/* Distance from the root of a new or reset distance map to a cell,
+ * by A* on the contracted graph. Like astarto(), findpath() will then
+ * give the cell path, but only cells on that path are in the map.
+ */
+int corridorto(CGRAPH *, DMAP *, CELL *);
+
+#endif
@@ -7,6 +7,11 @@
 #include "grid.h"
 #include "distance.h"
 
+/* cell sets as bitmaps, for compact maps and hybriddistanceto() */
+#define SETWORDS(n)	(((n) + 63) / 64)
+#define SETBIT(b,id)	((b)[(id) / 64] |= (uint64_t)1 << ((id) % 64))
+#define ISSET(b,id)	(((b)[(id) / 64] >> ((id) % 64)) & 1)
+
 /* mallocs and initializes the distance map structure to
  * match a particular grid.
  */
@@ -23,50 +28,347 @@ createdistancemap(GRID *g, CELL *c)
 
   dm->grid = g;
   dm->path = NULL;
-
-  dm->root_id = c->id;
-  dm->target_id = NC;
-  dm->farthest_id = NC;
-  dm->farthest = NV;
-  dm->rrow = c->row;
-  dm->rcol = c->col;
+  dm->steps = NULL;
+  dm->pathlen = 0;
+  dm->parent = NULL;
+  dm->buckets = NULL;
+  dm->bits = NULL;
+  dm->planes = NULL;
+  dm->walls = NULL;
+  dm->map16 = NULL;
+  dm->seen = NULL;
+  dm->counts = NULL;
+  dm->onpath = NULL;
   dm->msize = g->max;
 
   dm->map = malloc( g->max * sizeof(int) );
   if(!dm->map) { free(dm); return NULL; }
 
-  dm->frontier = malloc( g->max * sizeof(int) + 1 );
-  if(!dm->frontier) { free (dm->map); free(dm); return NULL; }
-
-  for (int m = 0; m < g->max; m++) {  dm->map[m] = NOT_VISITED; }
+  /* two frontiers, current and next, swapped every level */
+  dm->frontier = malloc( (g->max + 1) * sizeof(int) );
+  dm->nextfrontier = malloc( (g->max + 1) * sizeof(int) );
+  dm->fsize = g->max + 1;
+  if(!dm->frontier || !dm->nextfrontier) {
+    freedistancemap(dm);
+    return NULL;
+  }
 
-  dm->frontier[0] = dm->root_id;
-  dm->frontier[1] = NV;
+  resetdistancemap(dm, c);
 
   return dm;
 } /* createdistancemap() */
 
+/* Like createdistancemap(), but distances are kept in 16 bits, with a
+ * bitmap of cells reached in place of the NOT_VISITED and FRONTIER
+ * markers: two bytes and a bit per cell instead of twelve bytes.
+ * Frontiers start empty and grow to the widest level flooded, which
+ * in a maze is far short of a cell count. If a flood goes past
+ * COMPACT_MAXDIST, the map is widened to ints and stays that way.
+ * Only distanceto() floods these; read them with distanceofid().
+ */
+DMAP *
+createcompactdistancemap(GRID *g, CELL *c)
+{
+  DMAP *dm;
+
+  if(!g) { return NULL; }
+  if(!c) { return NULL; }
+
+  dm = (DMAP *)malloc( sizeof(DMAP) );
+  if(!dm) { return NULL; }
+
+  dm->grid = g;
+  dm->path = NULL;
+  dm->steps = NULL;
+  dm->pathlen = 0;
+  dm->parent = NULL;
+  dm->buckets = NULL;
+  dm->bits = NULL;
+  dm->planes = NULL;
+  dm->walls = NULL;
+  dm->map = NULL;
+  dm->frontier = NULL;
+  dm->nextfrontier = NULL;
+  dm->fsize = 0;
+  dm->counts = NULL;
+  dm->onpath = NULL;
+  dm->msize = g->max;
+
+  dm->map16 = malloc( g->max * sizeof(uint16_t) );
+  dm->seen = malloc( SETWORDS(g->max) * sizeof(uint64_t) );
+  if(!dm->map16 || !dm->seen) {
+    freedistancemap(dm);
+    return NULL;
+  }
+
+  resetdistancemap(dm, c);
+
+  return dm;
+} /* createcompactdistancemap() */
+
+/* distance from root to a cell, NOT_VISITED if not reached, for
+ * compact maps or not
+ */
+int
+distanceofid(DMAP *dm, int id)
+{
+  if(!dm || (id < 0) || (id >= dm->msize)) { return NV; }
+  if(dm->seen) {
+    if(!ISSET(dm->seen, id)) { return NOT_VISITED; }
+    if(dm->map16) { return dm->map16[id]; }
+  }
+  return dm->map[id];
+} /* distanceofid() */
+
+/* a compact map outgrew 16 bits, move to ints */
+static int
+widenmap(DMAP *dm)
+{
+  dm->map = malloc( dm->msize * sizeof(int) );
+  if(!dm->map) { return DISTANCE_ERROR; }
+
+  for(int m = 0; m < dm->msize; m ++) {
+    dm->map[m] = ISSET(dm->seen, m) ? dm->map16[m] : NOT_VISITED;
+  }
+  free(dm->map16);
+  dm->map16 = NULL;
+  return 0;
+} /* widenmap() */
+
+/* frees a path, if any */
+static void
+freepath(DMAP *dm)
+{
+  if(dm->path) { free(dm->path); }
+  dm->path = NULL;
+  dm->steps = NULL;
+  dm->pathlen = 0;
+} /* freepath() */
+
+/* A path is one allocation: len TRAIL nodes, already linked in
+ * order, followed by the same len cell ids as a plain int array.
+ * Fills in the links but not the ids.
+ */
+static int
+makepath(DMAP *dm, int len)
+{
+  TRAIL *walk;
+
+  freepath(dm);
+
+  walk = (TRAIL *)malloc( len * (sizeof(TRAIL) + sizeof(int)) );
+  if(!walk) { return DISTANCE_ERROR; }
+
+  dm->path = walk;
+  dm->steps = (int *)(walk + len);
+  dm->pathlen = len;
+
+  for(int k = 0; k < len; k ++) {
+    walk[k].prev = k ? &(walk[k-1]) : NULL;
+    walk[k].next = (k < len - 1) ? &(walk[k+1]) : NULL;
+  }
+  return 0;
+} /* makepath() */
+
+/* walk nodes get their ids from steps */
+static void
+linkpath(DMAP *dm)
+{
+  for(int k = 0; k < dm->pathlen; k ++) {
+    dm->path[k].cell_id = dm->steps[k];
+  }
+} /* linkpath() */
+
+/* makes a used distance map like new, for a new root cell on the
+ * same grid, without allocating anything.
+ */
+int
+resetdistancemap(DMAP *dm, CELL *c)
+{
+  if(!c) { return DISTANCE_ERROR; }
+  return resetdistancemapbyid(dm, c->id);
+} /* resetdistancemap() */
+
+/* the same by cell id, with no CELL structs involved */
+int
+resetdistancemapbyid(DMAP *dm, int id)
+{
+  if(!dm) { return DISTANCE_ERROR; }
+  if((id < 0) || (id >= dm->msize)) { return DISTANCE_ERROR; }
+
+  freepath(dm);
+
+  dm->root_id = id;
+  dm->target_id = NC;
+  dm->farthest_id = NC;
+  dm->farthest = NV;
+  dm->rrow = id / dm->grid->cols;
+  dm->rcol = id % dm->grid->cols;
+
+  if(dm->seen) {
+    /* compact maps go by the bitmap, the distances can stay */
+    for(int w = 0; w < SETWORDS(dm->msize); w ++) { dm->seen[w] = 0; }
+  } else {
+    for (int m = 0; m < dm->msize; m++) {  dm->map[m] = NOT_VISITED; }
+
+    dm->frontier[0] = dm->root_id;
+    dm->frontier[1] = NV;
+  }
+
+  if(dm->parent) { dm->parent[dm->root_id] = NC; }
+
+  return 0;
+} /* resetdistancemapbyid() */
+
+/* Have floods record the cell each cell was reached from, so
+ * findpath() can follow them straight back rather than search
+ * neighbors at every step. Costs one more int per cell.
+ */
+int
+trackparents(DMAP *dm)
+{
+  if(!dm) { return DISTANCE_ERROR; }
+
+  if(!dm->parent) {
+    dm->parent = malloc( dm->msize * sizeof(int) );
+    if(!dm->parent) { return DISTANCE_ERROR; }
+  }
+  dm->parent[dm->root_id] = NC;
+  return 0;
+} /* trackparents() */
+
 /* frees the various bits of a distance map */
 void
 freedistancemap(DMAP *dm)
 {
-  TRAIL *walker;
-
   if(!dm) { return; }
   if(dm->map) { free (dm->map); }
   if(dm->frontier) { free (dm->frontier); }
-
-  walker = dm->path;
-  while(walker) {
-    TRAIL *goner = walker;
-    walker = walker->next;
-    free(goner);
-  }
+  if(dm->nextfrontier) { free (dm->nextfrontier); }
+  if(dm->parent) { free (dm->parent); }
+  if(dm->buckets) { free (dm->buckets); }
+  if(dm->bits) { free (dm->bits); }
+  if(dm->planes) { free (dm->planes); }
+  if(dm->walls) { free (dm->walls); }
+  if(dm->map16) { free (dm->map16); }
+  if(dm->seen) { free (dm->seen); }
+  if(dm->counts) { free (dm->counts); }
+  if(dm->onpath) { free (dm->onpath); }
+
+  freepath(dm);
 
   free(dm);
 } /* freedistancemap() */
 
 
+/* compact maps keep frontiers only as big as the floods need,
+ * doubling, returns 0 or DISTANCE_ERROR
+ */
+static int
+growfrontiers(DMAP *dm, int need)
+{
+  int size, *f;
+
+  if(need > dm->msize) { need = dm->msize; }
+  if(need <= dm->fsize) { return 0; }
+  for(size = dm->fsize ? dm->fsize : 64; size < need; size *= 2) { ; }
+  if(size > dm->msize) { size = dm->msize; }
+
+  f = realloc(dm->frontier, size * sizeof(int));
+  if(!f) { return DISTANCE_ERROR; }
+  dm->frontier = f;
+  f = realloc(dm->nextfrontier, size * sizeof(int));
+  if(!f) { return DISTANCE_ERROR; }
+  dm->nextfrontier = f;
+  dm->fsize = size;
+  return 0;
+} /* growfrontiers() */
+
+/* distanceto() for compact maps. The seen bitmap does the work of
+ * the markers in map, and since it is set for cells when they are
+ * found, distances go in then too. A map that has been flooded
+ * answers from what it has, or floods again from scratch.
+ */
+static int
+compactdistanceto(DMAP *dm, int want, int lazy)
+{
+  int *cur, *next, *swap;
+  int nc, nn, far, found, fid, vid;
+
+  if(ISSET(dm->seen, dm->root_id)) {
+    /* farthest is only set by a complete flood */
+    if(ISSET(dm->seen, want) && (lazy || (dm->farthest != NV))) {
+      dm->target_id = want;
+      return lazy ? distanceofid(dm, want) : 0;
+    }
+    for(int w = 0; w < SETWORDS(dm->msize); w ++) { dm->seen[w] = 0; }
+    dm->farthest = NV;
+    dm->farthest_id = NC;
+  }
+
+  if(growfrontiers(dm, 1)) { return DISTANCE_ERROR; }
+  cur = dm->frontier;
+  cur[0] = dm->root_id;
+  nc = 1;
+  SETBIT(dm->seen, dm->root_id);
+  if(dm->map16) { dm->map16[dm->root_id] = 0; } else { dm->map[dm->root_id] = 0; }
+  far = found = 0;
+
+  while(nc) {
+    /* cells at distance far are all in */
+    if(!lazy && (far > dm->farthest)) {
+      dm->farthest = far;
+      dm->farthest_id = cur[0];
+    }
+    if(ISSET(dm->seen, want)) {
+      dm->target_id = want;
+      found = 1;
+      if(lazy) { break; }
+    }
+    if(dm->map16 && (far + 1 > COMPACT_MAXDIST) && widenmap(dm)) {
+      found = 0;
+      break;
+    }
+
+    /* each cell adds at most four more, but never past the grid */
+    if((nc * 4 > dm->fsize) && growfrontiers(dm, nc * 4)) {
+      found = 0;
+      break;
+    }
+    cur = dm->frontier;
+    next = dm->nextfrontier;
+
+    nn = 0;
+    for(int of = 0; of < nc; of ++) {
+      fid = cur[of];
+      for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+	vid = linkbyid(dm->grid, fid, go);
+	if((vid < 0) || (vid >= dm->msize) || ISSET(dm->seen, vid)) {
+	  continue;
+	}
+	SETBIT(dm->seen, vid);
+	if(dm->map16) {
+	  dm->map16[vid] = far + 1;
+	} else {
+	  dm->map[vid] = far + 1;
+	}
+	if(dm->parent) { dm->parent[vid] = fid; }
+	next[nn++] = vid;
+      }
+    }
+    swap = dm->frontier;
+    dm->frontier = dm->nextfrontier;
+    dm->nextfrontier = swap;
+    nc = nn;
+    far ++;
+  }
+
+  if(!found) {
+    return(DISTANCE_ERROR);
+  }
+  return lazy ? far : 0;
+} /* compactdistanceto() */
+
 /* This uses Dijkstra's flood-fill method to find a distance.
  * From each cell it tries all other reachable cells until it
  * gets a match. Usually not the fastest way to solve a maze,
@@ -78,104 +380,86 @@ freedistancemap(DMAP *dm)
 int
 distanceto(DMAP *dm, CELL *c, int lazy)
 {
-  int want;
+  if(!dm) { return DISTANCE_ERROR; }
+  if(!c) { return DISTANCE_ERROR; }
+
+  /* the flood reads connections by id, not through CELLs */
+  syncgrid(dm->grid);
+
+  return distancetobyid(dm, c->id, lazy);
+} /* distanceto() */
+
+/* The same by cell id. Like the grid's id functions, this leaves the
+ * syncgrid() to the caller, and so can run in several threads at once
+ * on one grid, each with its own DMAP.
+ */
+int
+distancetobyid(DMAP *dm, int want, int lazy)
+{
   int of, nf;
   int *frontier;
-  CELL *fcell;
-  CELL *vcell;
+  int fid, vid;
   int far, found;
-  int edges, walls;
 
   if(!dm) { return DISTANCE_ERROR; }
-  if(!c) { return DISTANCE_ERROR; }
+  if((want < 0) || (want >= dm->msize)) { return DISTANCE_ERROR; }
 
-  want = c->id;
+  if(dm->seen) { return compactdistanceto(dm, want, lazy); }
 
   /* the trivial case */
   if(lazy && (dm->root_id == want)) {
-    return 0;
     dm->map[want] = 0;
     dm->target_id = want;
+    return 0;
   }
 
   far = found = 0;
 
-  while( far < dm->msize ) {
+  while( dm->frontier[0] != NV ) {
 
-    frontier = malloc( dm->msize * sizeof(int) + 1 );
-    if(!frontier) { return DISTANCE_ERROR; }
+    frontier = dm->nextfrontier;
     nf = 0;
     frontier[0] = NV;
 
     for (of = 0; dm->frontier[of] != NOT_VISITED; of ++) {
-      dm->map[dm->frontier[of]] = far;
+      fid = dm->frontier[of];
+      dm->map[fid] = far;
 
       if(!lazy) {
         if (far > dm->farthest) {
 	  dm->farthest = far;
-	  dm->farthest_id = dm->frontier[of];
+	  dm->farthest_id = fid;
 	}
       }
 
-      fcell = visitid(dm->grid, dm->frontier[of]);
-      if(!fcell) {
-	free(frontier);
-	return DISTANCE_ERROR;
-      }
-
-      if(fcell->id == want) {
+      if(fid == want) {
         dm->target_id = want;
 	if(lazy) {
-	  free(dm->frontier);
-	  dm->frontier = frontier;
 	  return far;
 	} else {
 	  found = 1;
 	}
       }
 
-      edges = edgestatusbycell(dm->grid, fcell);
-      if(edges == EDGE_ERROR) {
-	free(frontier);
-	return DISTANCE_ERROR;
-      }
-
-      walls = wallstatusbycell(fcell);
-      if(walls == WALL_ERROR) {
-	free(frontier);
-	return DISTANCE_ERROR;
-      }
-      
-      walls |= edges;
-
       for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
-	int check = 0;
-	if(go == NORTH) { check = walls&NORTH_WALL; }
-	if(go == SOUTH) { check = walls&SOUTH_WALL; }
-	if(go == WEST ) { check = walls&WEST_WALL; }
-	if(go == EAST ) { check = walls&EAST_WALL; }
-	if(! check) {
-	  vcell = visitdir(dm->grid, fcell, go, ANY);
-	  if(! vcell ) {
-	    free(frontier);
-	    return DISTANCE_ERROR;
-	  }
+	vid = linkbyid(dm->grid, fid, go);
+	if((vid < 0) || (vid >= dm->msize)) {
+	  continue;
+	}
 
-	  /* only add it if we haven't seen it already */
-	  if(dm->map[vcell->id] == NOT_VISITED) {
-	    if(dm->map[vcell->id] != FRONTIER) {
-	      frontier[nf++] = vcell->id;
-	      dm->map[vcell->id] = FRONTIER;
-	    }
-	  }
-	} /* for wall check */
+	/* only add it if we haven't seen it already */
+	if(dm->map[vid] == NOT_VISITED) {
+	  frontier[nf++] = vid;
+	  dm->map[vid] = FRONTIER;
+	  if(dm->parent) { dm->parent[vid] = fid; }
+	}
       } /* for direction */
 
       frontier[nf] = NV;
 
     } /* for id in frontier */
     far ++;
-    free(dm->frontier);
+    dm->nextfrontier = dm->frontier;
     dm->frontier = frontier;
 
     // printf("\nDebug round %d\n", far);
@@ -187,146 +471,1282 @@ distanceto(DMAP *dm, CELL *c, int lazy)
     return 0;
   }
   return(DISTANCE_ERROR);
-} /* distanceto() */
+} /* distancetobyid() */
+
+/* go bottom up when a growing frontier passes 1/ALPHA of the
+ * unvisited cells, back to top down when a shrinking one drops under
+ * 1/BETA of all cells; the values from Beamer et al., for graphs
+ * whose frontiers can grow that big
+ */
+#define HYBRID_ALPHA	14
+#define HYBRID_BETA	24
+
+/* Direction optimizing flood (Beamer et al.). Same results and
+ * return values as distanceto(), on a new or reset map. Small
+ * frontiers are expanded top down, like distanceto(). Once the
+ * frontier is a good fraction of the cells left, it is cheaper to
+ * go bottom up: every unvisited cell asks whether any of its (at
+ * most four) connections is on the frontier, stopping at the first.
+ * Frontier and seen sets are bitmaps then, kept in the DMAP.
+ * A grid flood from one cell never has a frontier of more than
+ * about rows plus cols cells, so on big grids the switch comes only
+ * for the last few hundred cells, if at all, and this is mostly
+ * distanceto() with a seen bitmap. On small grids the bottom up
+ * steps do get used.
+ */
+int
+hybriddistanceto(DMAP *dm, CELL *c, int lazy)
+{
+  GRID *g;
+  uint64_t *inf, *outf, *seen, *swap;
+  uint64_t open;
+  int *frontier;
+  int want, words, far, found, bottomup;
+  int nf, lastnf, of, fid, vid, left, first, w, b;
+
+  if(!dm) { return DISTANCE_ERROR; }
+  if(!c) { return DISTANCE_ERROR; }
+  if(dm->seen) { return DISTANCE_ERROR; }	/* compact maps */
+
+  want = c->id;
+
+  /* the trivial case */
+  if(lazy && (dm->root_id == want)) {
+    dm->map[want] = 0;
+    dm->target_id = want;
+    return 0;
+  }
+
+  g = dm->grid;
+  words = SETWORDS(dm->msize);
+  if(!dm->bits) {
+    dm->bits = malloc( 3 * words * sizeof(uint64_t) );
+    if(!dm->bits) { return DISTANCE_ERROR; }
+  }
+  inf = dm->bits;
+  outf = inf + words;
+  seen = outf + words;
+  for(w = 0; w < words; w ++) { seen[w] = 0; }
+
+  syncgrid(g);
+
+  nf = 0;
+  for(of = 0; dm->frontier[of] != NV; of ++) {
+    fid = dm->frontier[of];
+    dm->map[fid] = 0;
+    SETBIT(seen, fid);
+    nf ++;
+  }
+  left = dm->msize - nf;
+  lastnf = 0;
+  first = dm->frontier[0];
+  far = found = bottomup = 0;
+
+  while(nf) {
+    /* cells at distance far are all in, as is first among them */
+    if(!lazy && (far > dm->farthest)) {
+      dm->farthest = far;
+      dm->farthest_id = first;
+    }
+    if(!found && ISSET(seen, want)) {
+      dm->target_id = want;
+      if(lazy) {
+        dm->frontier[0] = NV;
+	return far;
+      }
+      found = 1;
+    }
+
+    if(!bottomup && (nf > lastnf) && (nf > left / HYBRID_ALPHA)) {
+      /* frontier list to bitmap */
+      bottomup = 1;
+      for(w = 0; w < words; w ++) { inf[w] = 0; }
+      for(of = 0; of < nf; of ++) { SETBIT(inf, dm->frontier[of]); }
+    } else if(bottomup && (nf < lastnf) && (nf < dm->msize / HYBRID_BETA)) {
+      /* and back */
+      bottomup = 0;
+      of = 0;
+      for(w = 0; w < words; w ++) {
+	for(b = 0; inf[w] && (b < 64); b ++) {
+	  if((inf[w] >> b) & 1) { dm->frontier[of++] = w * 64 + b; }
+	}
+      }
+      dm->frontier[of] = NV;
+    }
+
+    lastnf = nf;
+    nf = 0;
+    first = NC;
+    if(bottomup) {
+      for(w = 0; w < words; w ++) { outf[w] = 0; }
+      for(w = 0; w < words; w ++) {
+	open = ~seen[w];
+	for(b = 0; open && (b < 64); b ++, open >>= 1) {
+	  vid = w * 64 + b;
+	  if(!(open & 1) || (vid >= dm->msize)) { continue; }
+	  for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+	    fid = linkbyid(g, vid, go);
+	    if((fid >= 0) && (fid < dm->msize) && ISSET(inf, fid)) {
+	      SETBIT(outf, vid);
+	      dm->map[vid] = far + 1;
+	      if(dm->parent) { dm->parent[vid] = fid; }
+	      if(!nf) { first = vid; }
+	      nf ++;
+	      break;
+	    }
+	  }
+	}
+      }
+      /* newly found cells only join seen after the scan */
+      for(w = 0; w < words; w ++) { seen[w] |= outf[w]; }
+      swap = inf;
+      inf = outf;
+      outf = swap;
+    } else {
+      frontier = dm->nextfrontier;
+      for(of = 0; dm->frontier[of] != NV; of ++) {
+	fid = dm->frontier[of];
+	for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+	  vid = linkbyid(g, fid, go);
+	  if((vid < 0) || (vid >= dm->msize) || ISSET(seen, vid)) {
+	    continue;
+	  }
+	  SETBIT(seen, vid);
+	  dm->map[vid] = far + 1;
+	  if(dm->parent) { dm->parent[vid] = fid; }
+	  frontier[nf++] = vid;
+	}
+      }
+      frontier[nf] = NV;
+      first = frontier[0];
+      dm->nextfrontier = dm->frontier;
+      dm->frontier = frontier;
+    }
+    far ++;
+    left -= nf;
+  } /* while walking as far as possible */
+
+  /* nothing left to continue from */
+  dm->frontier[0] = NV;
+
+  if(found) {
+    return 0;
+  }
+  return(DISTANCE_ERROR);
+} /* hybriddistanceto() */
+
+/* index of the lowest set bit, bits must not be 0 */
+static int
+lowbit(uint64_t bits)
+{
+#ifdef __GNUC__
+  return __builtin_ctzll(bits);
+#else
+  int b = 0;
+  while(!(bits & 1)) { bits >>= 1; b ++; }
+  return b;
+#endif
+} /* lowbit() */
+
+/* Fill out[i] for the cells of a bit row, from base, a run of set
+ * bits at a time: value, plus i itself if plusid (for parents, which
+ * are the cell one step back).
+ */
+static void
+runfill(int *out, int base, uint64_t bits, int value, int plusid)
+{
+  uint64_t run;
+  int b, len, i, end;
+
+  while(bits) {
+    b = lowbit(bits);
+    run = ~(bits >> b);
+    len = run ? lowbit(run) : 64 - b;
+    i = base + b;
+    end = i + len;
+    if(plusid) {
+      for( ; i < end; i ++) { out[i] = i + value; }
+    } else {
+      for( ; i < end; i ++) { out[i] = value; }
+    }
+    bits = (b + len < 64) ? bits & (~(uint64_t)0 << (b + len)) : 0;
+  }
+} /* runfill() */
+
+/* Bit parallel flood. Connections are kept as rows of bits, east
+ * and south, the same padded layout GRID_PACKED uses (and for those
+ * grids, the grid's own). A wave row then moves one step for 64
+ * cells at a time:
+ *    east   (wave & E) << 1		west   (wave >> 1) & E
+ *    south  wave above & S above	north  wave below & S
+ * with bits carried across words, and anything seen masked out.
+ * Each wave row keeps the span of words it has bits in, and only
+ * words near those spans are worked on, so thin waves in twisty
+ * mazes stay cheap. Distances go into the map a run of bits at a
+ * time, and parents, if tracked, come from which of the four moves
+ * reached a bit. Same results and return values as distanceto(),
+ * on a new or reset map; links are taken to be two way, and packed
+ * grids with one way links get a plain distanceto().
+ */
+int
+wavedistanceto(DMAP *dm, CELL *c, int lazy)
+{
+  GRID *g;
+  uint64_t *east, *south, *wave, *next, *seen;
+  uint64_t *row, *up, *down, *swap, bits, fromw, frome, fromn, froms;
+  int *active, *touched, *lo, *hi, *nlo, *nhi, *iswap;
+  int want, words, size, rows, cols, far, found;
+  int na, nt, r, rr, w, from, to, id, first;
+
+  if(!dm) { return DISTANCE_ERROR; }
+  if(!c) { return DISTANCE_ERROR; }
+  if(dm->seen) { return DISTANCE_ERROR; }	/* compact maps */
+
+  want = c->id;
+
+  /* the trivial case */
+  if(lazy && (dm->root_id == want)) {
+    dm->map[want] = 0;
+    dm->target_id = want;
+    return 0;
+  }
+
+  g = dm->grid;
+  rows = g->rows;
+  cols = g->cols;
+  words = (cols + 63) / 64;
+  size = rows * words;
+
+  syncgrid(g);
+  if(g->west) { return distanceto(dm, c, lazy); }
+
+  /* three planes of rows * words, and four ints per row for spans */
+  if(!dm->planes) {
+    dm->planes = malloc( 3 * size * sizeof(uint64_t) + 4 * rows * sizeof(int) );
+    if(!dm->planes) { return DISTANCE_ERROR; }
+  }
+  wave = dm->planes;
+  next = wave + size;
+  seen = next + size;
+  for(w = 0; w < 3 * size; w ++) {
+    dm->planes[w] = 0;
+  }
+  lo = (int *)(dm->planes + 3 * size);
+  hi = lo + rows;
+  nlo = hi + rows;
+  nhi = nlo + rows;
+  for(r = 0; r < rows; r ++) {
+    lo[r] = nlo[r] = words;
+    hi[r] = nhi[r] = -1;
+  }
+
+  /* other layouts get a copy of the packed bit rows, made once */
+  if(g->layout == GRID_PACKED) {
+    east = g->east;
+    south = g->south;
+  } else {
+    if(!dm->walls) {
+      dm->walls = calloc( 2 * size, sizeof(uint64_t) );
+      if(!dm->walls) { return DISTANCE_ERROR; }
+      for(id = 0; id < dm->msize; id ++) {
+	w = (id / cols) * words + (id % cols) / 64;
+	bits = (uint64_t)1 << ((id % cols) % 64);
+	if(linkbyid(g, id, EAST) != NC) { dm->walls[w] |= bits; }
+	if(linkbyid(g, id, SOUTH) != NC) { dm->walls[size + w] |= bits; }
+      }
+    }
+    east = dm->walls;
+    south = east + size;
+  }
+
+  /* from here on the frontier arrays hold rows, not cells */
+  active = dm->frontier;
+  touched = dm->nextfrontier;
+  first = dm->frontier[0];
+  for(na = 0; dm->frontier[na] != NV; na ++) {
+    id = dm->frontier[na];
+    r = id / cols;
+    w = (id % cols) / 64;
+    bits = (uint64_t)1 << ((id % cols) % 64);
+    wave[r * words + w] |= bits;
+    seen[r * words + w] |= bits;
+    if(w < lo[r]) { lo[r] = w; }
+    if(w > hi[r]) { hi[r] = w; }
+    dm->map[id] = 0;
+  }
+  na = 0;
+  for(r = 0; r < rows; r ++) {
+    if(hi[r] >= 0) { active[na++] = r; }
+  }
+
+  far = found = 0;
+
+  while(na) {
+    /* cells at distance far are all in, as is first among them */
+    if(!lazy && (far > dm->farthest)) {
+      dm->farthest = far;
+      dm->farthest_id = first;
+    }
+    if(!found && (dm->map[want] >= 0)) {
+      dm->target_id = want;
+      if(lazy) {
+        dm->frontier[0] = NV;
+	return far;
+      }
+      found = 1;
+    }
+
+    /* active rows are in order, so rows next to them come in order */
+    nt = 0;
+    for(int a = 0; a < na; a ++) {
+      rr = active[a] - 1;
+      if(nt && (rr <= touched[nt - 1])) { rr = touched[nt - 1] + 1; }
+      if(rr < 0) { rr = 0; }
+      for( ; (rr <= active[a] + 1) && (rr < rows); rr ++) {
+        touched[nt++] = rr;
+      }
+    }
+
+    first = NC;
+    for(int t = 0; t < nt; t ++) {
+      rr = touched[t];
+      row = wave + rr * words;
+      up = (rr > 0) ? row - words : NULL;
+      down = (rr < rows - 1) ? row + words : NULL;
+
+      /* words the wave can reach in this row */
+      from = lo[rr] - 1;
+      to = hi[rr] + 1;
+      if(up && (lo[rr-1] < from)) { from = lo[rr-1]; }
+      if(up && (hi[rr-1] > to)) { to = hi[rr-1]; }
+      if(down && (lo[rr+1] < from)) { from = lo[rr+1]; }
+      if(down && (hi[rr+1] > to)) { to = hi[rr+1]; }
+      if(from < 0) { from = 0; }
+      if(to > words - 1) { to = words - 1; }
+
+      for(w = from; w <= to; w ++) {
+        r = rr * words + w;
+	/* each move on its own, named for where the bits came from */
+	fromw = (row[w] & east[r]) << 1;
+	if(w > 0) { fromw |= (row[w-1] & east[r-1]) >> 63; }
+	frome = ((row[w] >> 1) | ((w < words - 1) ? row[w+1] << 63 : 0)) & east[r];
+	fromn = up ? up[w] & south[r - words] : 0;
+	froms = down ? down[w] & south[r] : 0;
+	bits = (fromw | frome | fromn | froms) & ~seen[r];
+	next[r] = bits;
+	if(!bits) { continue; }
+
+	seen[r] |= bits;
+	if(w < nlo[rr]) { nlo[rr] = w; }
+	nhi[rr] = w;
+
+	id = rr * cols + w * 64;
+	if(first == NC) { first = id + lowbit(bits); }
+	runfill(dm->map, id, bits, far + 1, 0);
+	if(dm->parent) {
+	  /* the order findpath() would look in: north, west, east, south */
+	  runfill(dm->parent, id, bits & fromn, -cols, 1);
+	  bits &= ~fromn;
+	  runfill(dm->parent, id, bits & fromw, -1, 1);
+	  bits &= ~fromw;
+	  runfill(dm->parent, id, bits & frome, 1, 1);
+	  runfill(dm->parent, id, bits & ~frome, cols, 1);
+	}
+      }
+    }
+
+    /* the old wave only had bits inside the spans of active rows */
+    for(int a = 0; a < na; a ++) {
+      r = active[a];
+      for(w = lo[r]; w <= hi[r]; w ++) { wave[r * words + w] = 0; }
+      lo[r] = words;
+      hi[r] = -1;
+    }
+    swap = wave;   wave = next;   next = swap;
+    iswap = lo;    lo = nlo;      nlo = iswap;
+    iswap = hi;    hi = nhi;      nhi = iswap;
+
+    na = 0;
+    for(int t = 0; t < nt; t ++) {
+      if(hi[touched[t]] >= 0) { active[na++] = touched[t]; }
+    }
+    far ++;
+  } /* while walking as far as possible */
+
+  /* nothing left to continue from */
+  dm->frontier[0] = NV;
+
+  if(found) {
+    return 0;
+  }
+  return(DISTANCE_ERROR);
+} /* wavedistanceto() */
+
+/* Bucket queue for astarto(). Buckets are doubly linked lists of
+ * cell ids, one list per priority, threaded through the two frontier
+ * arrays (frontier as next, nextfrontier as prev) so a search needs
+ * no per cell memory beyond the map. Only the bucket heads are extra.
+ */
+#define QCLOSED		-4	/* in next: cell has left the queue for good */
+
+static void
+bucketpush(DMAP *dm, int id, int pri)
+{
+  int *next = dm->frontier;
+  int *prev = dm->nextfrontier;
+
+  next[id] = dm->buckets[pri];
+  prev[id] = NC;
+  if(next[id] != NC) { prev[next[id]] = id; }
+  dm->buckets[pri] = id;
+} /* bucketpush() */
+
+static void
+bucketpull(DMAP *dm, int id, int pri)
+{
+  int *next = dm->frontier;
+  int *prev = dm->nextfrontier;
+
+  if(prev[id] != NC) {
+    next[prev[id]] = next[id];
+  } else {
+    dm->buckets[pri] = next[id];
+  }
+  if(next[id] != NC) { prev[next[id]] = prev[id]; }
+} /* bucketpull() */
+
+/* Bucket heads for astarto() and weighteddistanceto(), made empty on
+ * first use. No path is ever longer than every cell, nor an A* guess
+ * past rows+cols; weighted floods go round GRID_MAXWEIGHT+1 of them.
+ */
+static int
+needbuckets(DMAP *dm)
+{
+  int nb;
+
+  if(dm->buckets) { return 0; }
+
+  nb = dm->msize + dm->grid->rows + dm->grid->cols;
+  if(nb < GRID_MAXWEIGHT + 1) { nb = GRID_MAXWEIGHT + 1; }
+  dm->buckets = malloc( nb * sizeof(int) );
+  if(!dm->buckets) { return DISTANCE_ERROR; }
+  for(int b = 0; b < nb; b ++) { dm->buckets[b] = NC; }
+  return 0;
+} /* needbuckets() */
+
+/* Steps between two cells if no walls were in the way, the A*
+ * estimate here and in the corridor and HPA searches.
+ */
+int
+manhattan(GRID *g, int a, int b)
+{
+  return abs(a / g->cols - b / g->cols) + abs(a % g->cols - b % g->cols);
+} /* manhattan() */
+
+/* Binary heap over two arrays, keys and the ids that go with them,
+ * smallest key first; len is the count in it. The caller sizes the
+ * arrays for the most it will push.
+ */
+void
+heappush(int *keys, int *ids, int *len, int key, int id)
+{
+  int i = (*len) ++, up;
+
+  while(i > 0) {
+    up = (i - 1) / 2;
+    if(keys[up] <= key) { break; }
+    keys[i] = keys[up];
+    ids[i] = ids[up];
+    i = up;
+  }
+  keys[i] = key;
+  ids[i] = id;
+} /* heappush() */
+
+/* takes the id with the smallest key off a heap */
+int
+heappop(int *keys, int *ids, int *len)
+{
+  int top = ids[0], key, id, i, kid;
+
+  (*len) --;
+  key = keys[*len];
+  id = ids[*len];
+  i = 0;
+  while((kid = 2 * i + 1) < *len) {
+    if((kid + 1 < *len) && (keys[kid + 1] < keys[kid])) { kid ++; }
+    if(key <= keys[kid]) { break; }
+    keys[i] = keys[kid];
+    ids[i] = ids[kid];
+    i = kid;
+  }
+  keys[i] = key;
+  ids[i] = id;
+  return top;
+} /* heappop() */
+
+/* A* search for the distance to one target. Like a lazy distanceto(),
+ * but cells are taken in order of distance so far plus the fewest
+ * steps that could possibly remain (row and col difference), so the
+ * search leans toward the target instead of flooding every way.
+ * Needs a fresh (new or reset) distance map. Fills map for the cells
+ * it reaches and target_id, works with findpath() and trackparents().
+ * Returns the distance, or DISTANCE_ERROR if there is no path.
+ */
+int
+astarto(DMAP *dm, CELL *c)
+{
+  GRID *g;
+  int want;
+  int fmin, fmax;
+  int u, v, ng, rc;
+
+  if(!dm) { return DISTANCE_ERROR; }
+  if(!c) { return DISTANCE_ERROR; }
+  if(dm->seen) { return DISTANCE_ERROR; }	/* compact maps */
+
+  g = dm->grid;
+  want = c->id;
+
+  if(needbuckets(dm)) { return DISTANCE_ERROR; }
+
+  syncgrid(g);
+
+  u = dm->root_id;
+  dm->map[u] = 0;
+  fmin = fmax = manhattan(g, u, want);
+  bucketpush(dm, u, fmin);
+
+  rc = DISTANCE_ERROR;
+  while(fmin <= fmax) {
+    u = dm->buckets[fmin];
+    if(u == NC) { fmin ++; continue; }
+
+    bucketpull(dm, u, fmin);
+    dm->frontier[u] = QCLOSED;
+
+    if(u == want) {
+      dm->target_id = want;
+      rc = dm->map[u];
+      break;
+    }
+
+    ng = dm->map[u] + 1;
+    for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+      int f;
+
+      v = linkbyid(g, u, go);
+      if((v < 0) || (v >= dm->msize)) {
+	continue;
+      }
+
+      if(dm->map[v] == NOT_VISITED) {
+        dm->map[v] = ng;
+      } else if((dm->frontier[v] != QCLOSED) && (ng < dm->map[v])) {
+        /* found a shorter way to a queued cell */
+        bucketpull(dm, v, dm->map[v] + manhattan(g, v, want));
+	dm->map[v] = ng;
+      } else {
+	continue;
+      }
+
+      if(dm->parent) { dm->parent[v] = u; }
+      f = ng + manhattan(g, v, want);
+      bucketpush(dm, v, f);
+      if(f > fmax) { fmax = f; }
+    } /* for direction */
+  } /* while queue not empty */
+
+  /* leave the buckets empty for next time */
+  for(int b = fmin; b <= fmax; b ++) { dm->buckets[b] = NC; }
+
+  /* frontier arrays were borrowed, there's no flood to continue */
+  dm->frontier[0] = NV;
+
+  return rc;
+} /* astarto() */
+
+/* Dijkstra's algorithm, with cells costing what weightbyid() says to
+ * enter. Weights are small, so the queue is Dial's bucket queue: the
+ * cells waiting are never more than GRID_MAXWEIGHT past the nearest
+ * one, and a ring of that many buckets holds them all. Buckets are
+ * the astarto() lists, so a push, pull or move is a few stores.
+ *
+ * Same return values as distanceto(), on a new or reset map. Map
+ * distances are summed weights; not lazy, farthest is the costliest
+ * cell to reach. Distances no longer drop by one a step, so parents
+ * are always tracked for findpath().
+ */
+int
+weighteddistanceto(DMAP *dm, CELL *c, int lazy)
+{
+  GRID *g;
+  int want, ring, cur, queued, found, last;
+  int u, v, nd;
+
+  if(!dm) { return DISTANCE_ERROR; }
+  if(!c) { return DISTANCE_ERROR; }
+  if(dm->seen) { return DISTANCE_ERROR; }	/* compact maps */
+  if(trackparents(dm) || needbuckets(dm)) { return DISTANCE_ERROR; }
+
+  g = dm->grid;
+  want = c->id;
+  ring = GRID_MAXWEIGHT + 1;
+
+  syncgrid(g);
+
+  u = dm->root_id;
+  dm->map[u] = 0;
+  bucketpush(dm, u, 0);
+  queued = 1;
+  cur = found = 0;
+  last = u;
+
+  while(queued) {
+    u = dm->buckets[cur % ring];
+    if(u == NC) { cur ++; continue; }
+
+    bucketpull(dm, u, cur % ring);
+    queued --;
+    dm->frontier[u] = QCLOSED;
+    last = u;
+
+    if(u == want) {
+      dm->target_id = want;
+      found = 1;
+      if(lazy) { break; }
+    }
+
+    for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+      v = linkbyid(g, u, go);
+      if((v < 0) || (v >= dm->msize)) {
+	continue;
+      }
+
+      nd = cur + (g->weights ? g->weights[v] : 1);
+      if(dm->map[v] == NOT_VISITED) {
+        queued ++;
+      } else if((dm->frontier[v] != QCLOSED) && (nd < dm->map[v])) {
+        bucketpull(dm, v, dm->map[v] % ring);
+      } else {
+        continue;
+      }
+
+      dm->map[v] = nd;
+      dm->parent[v] = u;
+      bucketpush(dm, v, nd % ring);
+    } /* for direction */
+  } /* while queue not empty */
+
+  if(!lazy) {
+    dm->farthest = dm->map[last];
+    dm->farthest_id = last;
+  }
+
+  /* leave the buckets empty for next time */
+  for(int b = 0; b < ring; b ++) { dm->buckets[b] = NC; }
+
+  /* frontier arrays were borrowed, there's no flood to continue */
+  dm->frontier[0] = NV;
+
+  if(!found) { return DISTANCE_ERROR; }
+  return lazy ? dm->map[want] : 0;
+} /* weighteddistanceto() */
+
+/* Backward distances in a bidistanceto() map, kept clear of the
+ * other negative markers.
+ */
+#define BACKWARD(d)	(-10 - (d))
+#define BACKDIST(m)	(-10 - (m))
+#define ISBACKWARD(m)	((m) <= BACKWARD(0))
+
+/* Bidirectional breadth first search for the distance to one target.
+ * One search floods out from the root and another from the target,
+ * a level at a time, always growing whichever frontier is smaller,
+ * until they touch. In long corridors the two half searches cover
+ * far fewer cells than one flood all the way across.
+ *
+ * The two queues are the frontier arrays, and backward distances
+ * are stored in the map as BACKWARD(d) until the end. Then the
+ * target half of the path is given forward distances (and parents),
+ * the rest of the backward search is wiped, and the map looks like
+ * a lazy distanceto() result, ready for findpath().
+ * Needs a fresh (new or reset) distance map. Returns the distance,
+ * or DISTANCE_ERROR if there is no path.
+ */
+int
+bidistanceto(DMAP *dm, CELL *c)
+{
+  GRID *g;
+  int *fq, *bq;
+  int fh, ft, fd, bh, bt, bd;
+  int want, best, mu, mv;
+  int u, v, end, b;
+
+  if(!dm) { return DISTANCE_ERROR; }
+  if(!c) { return DISTANCE_ERROR; }
+  if(dm->seen) { return DISTANCE_ERROR; }	/* compact maps */
+
+  g = dm->grid;
+  want = c->id;
+
+  dm->map[dm->root_id] = 0;
+  if(dm->root_id == want) {
+    dm->target_id = want;
+    return 0;
+  }
+
+  syncgrid(g);
+
+  fq = dm->frontier;
+  bq = dm->nextfrontier;
+  fq[0] = dm->root_id;
+  bq[0] = want;
+  dm->map[want] = BACKWARD(0);
+  fh = bh = 0;
+  ft = bt = 1;
+  fd = bd = 0;
+  best = mu = mv = NC;
+
+  while((fh < ft) && (bh < bt) && (best == NC)) {
+    if(ft - fh <= bt - bh) {
+      /* forward a level */
+      for(end = ft; fh < end; fh ++) {
+        u = fq[fh];
+	for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+	  v = linkbyid(g, u, go);
+	  if((v < 0) || (v >= dm->msize)) { continue; }
+
+	  if(dm->map[v] == NOT_VISITED) {
+	    dm->map[v] = fd + 1;
+	    if(dm->parent) { dm->parent[v] = u; }
+	    fq[ft++] = v;
+	  } else if(ISBACKWARD(dm->map[v])) {
+	    b = fd + 1 + BACKDIST(dm->map[v]);
+	    if((best == NC) || (b < best)) { best = b; mu = u; mv = v; }
+	  }
+	}
+      }
+      fd ++;
+    } else {
+      /* backward a level, along connections that lead in */
+      for(end = bt; bh < end; bh ++) {
+        u = bq[bh];
+	for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+	  v = linkbyid(g, u, go);
+	  if((v < 0) || (v >= dm->msize)) { continue; }
+	  if(linkbyid(g, v, opposite(go)) != u) { continue; }
+
+	  if(dm->map[v] == NOT_VISITED) {
+	    dm->map[v] = BACKWARD(bd + 1);
+	    bq[bt++] = v;
+	  } else if(dm->map[v] >= 0) {
+	    b = dm->map[v] + 1 + bd;
+	    if((best == NC) || (b < best)) { best = b; mu = v; mv = u; }
+	  }
+	}
+      }
+      bd ++;
+    }
+  } /* while both searches can grow */
+
+  if(best != NC) {
+    /* give the target half forward distances, mu -> mv -> ... -> want */
+    u = mu;
+    v = mv;
+    while(1) {
+      b = BACKDIST(dm->map[v]);	/* steps still to go */
+      dm->map[v] = dm->map[u] + 1;
+      if(dm->parent) { dm->parent[v] = u; }
+      if(v == want) { break; }
+
+      u = v;
+      for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+        v = linkbyid(g, u, go);
+	if((v >= 0) && (v < dm->msize) && ISBACKWARD(dm->map[v]) &&
+	   (BACKDIST(dm->map[v]) == b - 1)) {
+	  break;
+	}
+	v = NC;
+      }
+      if(v == NC) { best = NC; break; }	/* shouldn't happen */
+    }
+    dm->target_id = want;
+  }
+
+  /* wipe what's left of the backward search */
+  for(b = 0; b < bt; b ++) {
+    if(ISBACKWARD(dm->map[bq[b]])) { dm->map[bq[b]] = NOT_VISITED; }
+  }
+
+  /* frontier arrays were borrowed, there's no flood to continue */
+  dm->frontier[0] = NV;
+
+  return (best == NC) ? DISTANCE_ERROR : best;
+} /* bidistanceto() */
 
 int
 findpath(DMAP *dm)
 {
-  TRAIL *walk;
-  TRAIL *step;
   int id, sid, curdis;
-  int si, sj;
+  int len, k, go;
 
   if(!dm) { return DISTANCE_ERROR; }
 
+  freepath(dm);
+
   /* this is the case when distanceto() wasn't run, or failed. */
   if(dm->target_id < 0) {  return DISTANCE_ERROR; }
+  if(distanceofid(dm, dm->target_id) < 0) {  return DISTANCE_ERROR; }
+
+  len = distanceofid(dm, dm->target_id) + 1;
+  if(dm->parent) {
+    /* weighted distances don't count steps, so count them here */
+    len = 1;
+    for(id = dm->target_id; id != dm->root_id; id = dm->parent[id]) {
+      if((id < 0) || (len > dm->msize)) { return DISTANCE_ERROR; }
+      len ++;
+    }
+  }
+  if(makepath(dm, len)) { return DISTANCE_ERROR; }
 
-  walk = (TRAIL *)malloc( sizeof(TRAIL) );
-  if(!walk) { return DISTANCE_ERROR; }
-  
-  walk->cell_id = id = dm->target_id;
-  walk->next = NULL;
-  walk->prev = NULL;
-
-  while( (curdis = dm->map[id]) ) {
-    step = (TRAIL *)malloc( sizeof(TRAIL) );
-    /* this leaks memory, but only when malloc fails */
-    if(!step) { return DISTANCE_ERROR; }
-     
-    step->next = walk;
-    step->prev = NULL;
-    walk = step;
+  id = dm->target_id;
+  for(k = len - 1; k >= 0; k --) {
+    dm->steps[k] = id;
+    if(k == 0) { break; }
+
+    if(dm->parent) {
+      id = dm->parent[id];
+      continue;
+    }
 
     /* At least one neighbor should be curdis - 1,
      * but there might be multiple equally short paths.
      */
-    si = id / ( dm->grid->cols );
-    sj = id % ( dm->grid->cols );
-
-#define TEST_SID \
-	if(curdis == dm->map[sid] + 1) { \
-	  if(isconnectedbyid(dm->grid, id, sid, ANYDIR) != NC) { \
-	    walk->cell_id = id = sid; \
-	    continue; \
-	  } \
-	}
-
-    if(si) {
-      sid = (si - 1) * (dm->grid->cols) + sj;
-      TEST_SID;
-    }
-    if(sj) {
-      sid = si * (dm->grid->cols) + sj - 1;
-      TEST_SID;
-    }
-    if(si < (dm->grid->cols - 1)) {
-      sid = (si + 1) * (dm->grid->cols) + sj;
-      TEST_SID;
+    curdis = distanceofid(dm, id);
+    for(go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+      sid = linkbyid(dm->grid, id, go);
+      if((sid >= 0) && (sid < dm->msize) && (distanceofid(dm, sid) == curdis - 1)) {
+	break;
+      }
     }
-    if(sj < (dm->grid->rows - 1)) {
-      sid = si * (dm->grid->cols) + sj + 1;
-      TEST_SID;
+    if(go == FOURDIRECTIONS) {
+      /* this shouldn't be reached */
+      freepath(dm);
+      return DISTANCE_ERROR;
     }
-
-    /* this shouldn't be reached */
-    walk->cell_id = id = NV;
-    break;
+    id = sid;
   }
 
-  dm->path = walk;
-  if(curdis || id == NV) {
+  if(dm->steps[0] != dm->root_id) {
+    freepath(dm);
     return DISTANCE_ERROR;
   }
 
+  linkpath(dm);
   return 0;
 } /* findpath() */
 
+/* Counts every shortest path from the root to the target, where
+ * findpath() gives just one, without walking any of them. Cells are
+ * taken a level at a time: the paths to a cell are the sum of the
+ * paths to its neighbors one step nearer the root. Then a pass back
+ * down the levels from the target marks each cell one step nearer
+ * than a marked neighbor; those are the cells on some shortest path.
+ *
+ * Needs a distanceto() flood that found the target, lazy or not.
+ * Only levels short of the target are used, and a lazy flood has
+ * finished those. Counts stop at UINT64_MAX rather than wrap. Fills
+ * counts (for cells nearer than the target, and the target) and
+ * onpath, read with onanypath(). Returns the number of cells on any
+ * shortest path, or DISTANCE_ERROR.
+ */
+int
+countpaths(DMAP *dm)
+{
+  int *order, *start;
+  int far, n, id, v, d, k, marked;
+  uint64_t sum;
+
+  if(!dm) { return DISTANCE_ERROR; }
+  if(dm->target_id < 0) { return DISTANCE_ERROR; }
+  far = distanceofid(dm, dm->target_id);
+  if(far < 0) { return DISTANCE_ERROR; }
+
+  if(!dm->counts) {
+    dm->counts = malloc( dm->msize * sizeof(uint64_t) );
+    if(!dm->counts) { return DISTANCE_ERROR; }
+  }
+  if(!dm->onpath) {
+    dm->onpath = malloc( SETWORDS(dm->msize) * sizeof(uint64_t) );
+    if(!dm->onpath) { return DISTANCE_ERROR; }
+  }
+  for(int w = 0; w < SETWORDS(dm->msize); w ++) { dm->onpath[w] = 0; }
+
+  /* the cells of the map in level order, by counting sort */
+  order = malloc( (dm->msize + 1) * sizeof(int) );
+  start = malloc( (far + 2) * sizeof(int) );
+  if(!order || !start) {
+    if(order) { free(order); }
+    if(start) { free(start); }
+    return DISTANCE_ERROR;
+  }
+  for(k = 0; k < far + 2; k ++) { start[k] = 0; }
+  for(id = 0; id < dm->msize; id ++) {
+    d = distanceofid(dm, id);
+    if((d >= 0) && (d < far)) { start[d + 1] ++; }
+  }
+  for(k = 0; k < far; k ++) { start[k + 1] += start[k]; }
+  for(id = 0; id < dm->msize; id ++) {
+    d = distanceofid(dm, id);
+    if((d >= 0) && (d < far)) { order[start[d] ++] = id; }
+  }
+  /* start[d] is now where level d ends, and the target goes last */
+  n = far ? start[far - 1] : 0;
+  order[n++] = dm->target_id;
+
+  for(k = 0; k < n; k ++) {
+    id = order[k];
+    d = distanceofid(dm, id);
+    if(d == 0) {
+      dm->counts[id] = 1;
+      continue;
+    }
+    sum = 0;
+    for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+      v = linkbyid(dm->grid, id, go);
+      if((v < 0) || (v >= dm->msize) || (distanceofid(dm, v) != d - 1)) {
+        continue;
+      }
+      sum += dm->counts[v];
+      if(sum < dm->counts[v]) { sum = UINT64_MAX; break; }
+    }
+    dm->counts[id] = sum;
+  }
+
+  SETBIT(dm->onpath, dm->target_id);
+  marked = 1;
+  for(k = n - 2; k >= 0; k --) {
+    id = order[k];
+    d = distanceofid(dm, id);
+    for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+      v = linkbyid(dm->grid, id, go);
+      if((v >= 0) && (v < dm->msize) && (distanceofid(dm, v) == d + 1) &&
+         ISSET(dm->onpath, v)) {
+        SETBIT(dm->onpath, id);
+	marked ++;
+	break;
+      }
+    }
+  }
+
+  free(order);
+  free(start);
+  return marked;
+} /* countpaths() */
+
+/* 1 if countpaths() found a cell on a shortest path, else 0 */
+int
+onanypath(DMAP *dm, int id)
+{
+  if(!dm || !dm->onpath || (id < 0) || (id >= dm->msize)) { return 0; }
+  return ISSET(dm->onpath, id);
+} /* onanypath() */
+
+/* The longest path in a perfect maze (a tree) in one depth first
+ * pass from cell 0: each cell learns the deepest leaf below it, and
+ * every junction where two of those meet is a candidate. The DMAP's
+ * own arrays are borrowed for the walk, so nothing beyond a normal
+ * distance map is allocated. Returns NULL if a loop turns up. The
+ * result is a path, not a flood: only cells on the path are in map.
+ */
 DMAP *
-findlongestpath(GRID *g)
+findtreediameter(GRID *g)
 {
-  DMAP *first, *second;
-  CELL *pa, *pb;
-  int rc, fid;
+  DMAP *dm;
+  CELL *c;
+  int *stack, *leaf, *height, *up, *list;
+  int sp, u, v, go, h;
+  int best, ea, eb, da, db, a, b, i, j;
 
-  if(!g) {
+  if(!g) { return NULL; }
+
+  c = visitid(g, 0);
+  if(!c) { return NULL; }
+
+  dm = createdistancemap(g, c);
+  if(!dm) { return NULL; }
+  if(trackparents(dm)) {
+    freedistancemap(dm);
     return NULL;
   }
 
-  pa = visitid(g, 0);
-  pb = visitid(g, g->max - 1);
-  if(!pa || !pb) {
+  syncgrid(g);
+
+  stack = dm->frontier;		/* cells on the way down */
+  leaf = dm->nextfrontier;	/* deepest leaf below each cell */
+  height = dm->map;		/* steps down to that leaf */
+  up = dm->parent;		/* tree parent */
+
+  best = ea = eb = 0;
+  height[0] = 0;
+  leaf[0] = 0;
+  sp = 0;
+  stack[sp++] = 0;
+  go = FIRSTDIR;
+
+  while(sp) {
+    u = stack[sp - 1];
+    for( ; go < FOURDIRECTIONS; go ++) {
+      v = linkbyid(g, u, go);
+      if((v == NC) || (v == up[u])) { continue; }
+      if(height[v] != NOT_VISITED) {
+        /* reached twice, not a tree */
+	freedistancemap(dm);
+	return NULL;
+      }
+      up[v] = u;
+      height[v] = 0;
+      leaf[v] = v;
+      stack[sp++] = v;
+      break;
+    }
+    if(go < FOURDIRECTIONS) {
+      go = FIRSTDIR;
+      continue;
+    }
+
+    /* u is done, fold it into its parent */
+    sp --;
+    v = u;
+    u = up[v];
+    if(u == NC) { break; }
+
+    h = height[v] + 1;
+    if(height[u] + h > best) {
+      best = height[u] + h;
+      ea = leaf[u];
+      eb = leaf[v];
+    }
+    if(h > height[u]) {
+      height[u] = h;
+      leaf[u] = leaf[v];
+    }
+
+    /* pick up the parent's directions after the one just taken */
+    for(go = FIRSTDIR; linkbyid(g, u, go) != v; go ++) { ; }
+    go ++;
+  }
+
+  /* lay the path out from ea to eb, meeting at their common ancestor */
+  for(da = 0, a = ea; up[a] != NC; a = up[a]) { da ++; }
+  for(db = 0, b = eb; up[b] != NC; b = up[b]) { db ++; }
+
+  list = dm->nextfrontier;
+  a = ea;
+  b = eb;
+  i = 0;
+  j = best;
+  for(h = da; h > db; h --) { list[i++] = a; a = up[a]; }
+  for(h = db; h > da; h --) { list[j--] = b; b = up[b]; }
+  while(a != b) {
+    list[i++] = a; a = up[a];
+    list[j--] = b; b = up[b];
+  }
+  list[i] = a;
+
+  /* like the two flood method, start at the end farther from cell 0 */
+  if(db > da) {
+    for(i = 0, j = best; i < j; i ++, j --) {
+      h = list[i]; list[i] = list[j]; list[j] = h;
+    }
+  }
+
+  resetdistancemap(dm, visitid(g, list[0]));
+  for(i = 0; i <= best; i ++) {
+    dm->map[list[i]] = i;
+    if(i) { dm->parent[list[i]] = list[i - 1]; }
+  }
+  dm->frontier[0] = NV;
+  dm->farthest = best;
+  dm->farthest_id = dm->target_id = list[best];
+
+  if(findpath(dm) == DISTANCE_ERROR) {
+    freedistancemap(dm);
     return NULL;
   }
 
-  first = createdistancemap(g, pa);
-  if(!first) {
+  return dm;
+} /* findtreediameter() */
+
+/* The exact longest path for grids with loops, where two floods can
+ * come up short. This is iFUB (Crescenzi et al.): flood from a cell
+ * near the middle of a two flood path, then flood from the cells
+ * farthest from it, a level at a time. Nothing is more than 2i from
+ * a cell at level i, so once the best found reaches 2i, the levels
+ * left can't beat it. Usually a handful of floods, all cells in the
+ * worst case.
+ */
+DMAP *
+findexactlongestpath(GRID *g)
+{
+  DMAP *dm, *mid;
+  CELL *c;
+  int *bylevel, *start;
+  int lb, best, far, i, k;
+
+  if(!g) { return NULL; }
+
+  c = visitid(g, 0);
+  if(!c) { return NULL; }
+
+  dm = createdistancemap(g, c);
+  if(!dm) { return NULL; }
+  if(trackparents(dm)) {
+    freedistancemap(dm);
     return NULL;
   }
 
-  rc = distanceto(first, pb, 0);
-  if(rc == DISTANCE_ERROR) {
-    freedistancemap(first);
+  /* two floods: from cell 0 to a, from a to b, for a lower bound */
+  if(distanceto(dm, c, 0) == DISTANCE_ERROR) {
+    freedistancemap(dm);
     return NULL;
   }
+  c = visitid(g, dm->farthest_id);
+  resetdistancemap(dm, c);
+  if(distanceto(dm, c, 0) == DISTANCE_ERROR) {
+    freedistancemap(dm);
+    return NULL;
+  }
+  best = dm->root_id;
+  lb = dm->farthest;
 
-  fid = first->farthest_id;
-  if(fid == 0) {
-    /* Point A was id 0, if the furthest point from Point A is
-     * Point A, we've got a real degenerate case.
-     */
-    TRAIL *walk = (TRAIL *)malloc( sizeof(TRAIL) );
-    walk->next = walk->prev = NULL;
-    walk->cell_id = fid;
-    first->path = walk;
-    return first;
+  dm->target_id = dm->farthest_id;
+  if(findpath(dm) == DISTANCE_ERROR) {
+    freedistancemap(dm);
+    return NULL;
   }
+  c = visitid(g, dm->steps[dm->pathlen / 2]);
 
-  freedistancemap(first);
-  pb = visitid(g, fid);
-  if(!pb) {
+  mid = createdistancemap(g, c);
+  if(!mid) {
+    freedistancemap(dm);
     return NULL;
   }
+  if(distanceto(mid, c, 0) == DISTANCE_ERROR) {
+    freedistancemap(mid);
+    freedistancemap(dm);
+    return NULL;
+  }
+  far = mid->farthest;
+  if(far > lb) {
+    best = mid->root_id;
+    lb = far;
+  }
 
-  second = createdistancemap(g, pb);
-  if(!second) {
+  /* sort the cells mid reached by distance from it */
+  bylevel = malloc( g->max * sizeof(int) );
+  start = malloc( (far + 2) * sizeof(int) );
+  if(!bylevel || !start) {
+    if(bylevel) { free(bylevel); }
+    if(start) { free(start); }
+    freedistancemap(mid);
+    freedistancemap(dm);
     return NULL;
   }
+  for(i = 0; i <= far + 1; i ++) { start[i] = 0; }
+  for(k = 0; k < g->max; k ++) {
+    if(mid->map[k] >= 0) { start[mid->map[k] + 1] ++; }
+  }
+  for(i = 1; i <= far + 1; i ++) { start[i] += start[i-1]; }
+  for(k = 0; k < g->max; k ++) {
+    if(mid->map[k] >= 0) { bylevel[start[mid->map[k]] ++] = k; }
+  }
+  /* level i is now bylevel[start[i-1]] up to bylevel[start[i]] */
+
+  for(i = far; (i > 0) && (lb < 2 * i); i --) {
+    for(k = start[i-1]; (k < start[i]) && (lb < 2 * i); k ++) {
+      c = visitid(g, bylevel[k]);
+      resetdistancemap(dm, c);
+      if(distanceto(dm, c, 0) == DISTANCE_ERROR) {
+	free(bylevel);
+	free(start);
+	freedistancemap(mid);
+	freedistancemap(dm);
+	return NULL;
+      }
+      if(dm->farthest > lb) {
+	best = bylevel[k];
+	lb = dm->farthest;
+      }
+    }
+  }
 
-  rc = distanceto(second, pa, 0);
-  if(rc == DISTANCE_ERROR) {
-    freedistancemap(second);
+  free(bylevel);
+  free(start);
+  freedistancemap(mid);
+
+  /* flood again from the winner for the path */
+  c = visitid(g, best);
+  resetdistancemap(dm, c);
+  if(distanceto(dm, c, 0) == DISTANCE_ERROR) {
+    freedistancemap(dm);
     return NULL;
   }
+  dm->target_id = dm->farthest_id;
+  if(findpath(dm) == DISTANCE_ERROR) {
+    freedistancemap(dm);
+    return NULL;
+  }
+
+  return dm;
+} /* findexactlongestpath() */
 
-  second->target_id = second->farthest_id;
-  rc = findpath(second);
-  if(rc == DISTANCE_ERROR) {
-    freedistancemap(second);
+/* The longest path, with a full map from its start, as the two flood
+ * method always gave: perfect mazes find the path in one pass, then
+ * flood once from its first cell for the rest of the map.
+ */
+DMAP *
+findlongestpath(GRID *g)
+{
+  DMAP *dm;
+  CELL *c;
+  int links, end;
+
+  if(!g) {
     return NULL;
   }
 
-  return second;
+  /* a perfect maze has one fewer connection than it has cells,
+   * those get the single pass tree method
+   */
+  syncgrid(g);
+  links = 0;
+  for(int id = 0; id < g->max; id ++) {
+    if(linkbyid(g, id, EAST) != NC) { links ++; }
+    if(linkbyid(g, id, SOUTH) != NC) { links ++; }
+  }
+  if(links == g->max - 1) {
+    dm = findtreediameter(g);
+    if(dm) {
+      /* a tree has one path between two cells, the flood finds it again */
+      end = dm->target_id;
+      c = visitid(g, dm->root_id);
+      resetdistancemap(dm, c);
+      if(distanceto(dm, c, 0) == DISTANCE_ERROR) {
+	freedistancemap(dm);
+	return NULL;
+      }
+      dm->farthest_id = dm->target_id = end;
+      if(findpath(dm) == DISTANCE_ERROR) {
+	freedistancemap(dm);
+	return NULL;
+      }
+      return dm;
+    }
+  }
+
+  return findexactlongestpath(g);
 } /* findlongestpath() */
 
 int
@@ -363,7 +1783,7 @@ namewalker(DMAP *dm, int cid, void*param)
   if(param) {
     namebyid(dm->grid, cid, (char*)param);
   } else {
-    snprintf(scratch, BUFSIZ, "%d", dm->map[cid]);
+    snprintf(scratch, BUFSIZ, "%d", distanceofid(dm, cid));
     namebyid(dm->grid, cid, scratch);
   }
   return 0;
@@ -389,6 +1809,7 @@ namepath(DMAP *dm, char *fname, char *mname, char *lname)
   if(lname) {
     namebyid(dm->grid, dm->target_id, lname);
   }
+  return 0;
 } /* namepath */
 
 /* print the distance map for testing */
@@ -402,7 +1823,7 @@ ascii_dmap(DMAP *dm)
   f = 0;
   for(i = 0; i < dm->grid->rows; i++) {
     for(j = 0; j < dm->grid->cols; j++) {
-      d = dm->map[f++];
+      d = distanceofid(dm, f++);
       if(d == NOT_VISITED) {
 	printf("unk ");
       } else if(d == FRONTIER) {
@@ -8,6 +8,9 @@
 #define NOT_VISITED       NV
 #define FRONTIER          -3
 
+/* farthest a compact map goes before it is widened to ints */
+#define COMPACT_MAXDIST   65535
+
 /* your typical double linked list for holding a pathway through a maze */
 typedef struct trail_t {
   int cell_id;
@@ -15,6 +18,36 @@ typedef struct trail_t {
   struct trail_t *prev;
 } TRAIL;
 
+/* Which maps go with which solvers.
+ *
+ * There are two kinds of map. createdistancemap() gives a full map,
+ * distances in map as ints. createcompactdistancemap() gives a compact
+ * one: seen is set, and distances are in map16 until one passes
+ * COMPACT_MAXDIST, when map takes over. Read either with distanceofid().
+ *
+ * Compact maps work with distanceto(), distancetobyid(),
+ * trackparents(), findpath(), countpaths() and the reset functions.
+ * Every other solver wants a full map and returns DISTANCE_ERROR for a
+ * compact one: hybriddistanceto(), wavedistanceto(), astarto(),
+ * weighteddistanceto(), bidistanceto(), paralleldistanceto(),
+ * corridorto() and hpato().
+ *
+ * Solvers add their own workspace to a map the first time they use
+ * it, and keep it until freedistancemap(): buckets (astarto() and
+ * weighteddistanceto()), bits (hybriddistanceto()), planes and walls
+ * (wavedistanceto()), counts and onpath (countpaths()). parent is
+ * there once trackparents() is called, and weighteddistanceto() calls
+ * it itself. path, steps and pathlen come from findpath() and go with
+ * the next reset.
+ *
+ * Only distanceto() and distancetobyid() leave a frontier that a later
+ * lazy call can carry on from. Every other solver needs a new or reset
+ * map, and leaves nothing to continue, so reset a map before handing
+ * it from one solver to another. After astarto(), bidistanceto(),
+ * corridorto() and hpato() only some cells are in the map. After
+ * weighteddistanceto() the map holds summed weights, not steps.
+ */
+
 /* no part of this structure is intended to be changed by maze generators */
 typedef struct {
   GRID *grid;
@@ -23,22 +56,87 @@ typedef struct {
   int farthest_id;	/* set with non-lazy distance maps */
   int farthest;		/* set with non-lazy distance maps */
   int rrow, rcol;	/* root row, col values, set at creation time */
-  int msize;		/* size of map; frontier always one larger */
+  int msize;		/* size of map; frontiers always one larger */
   int *map;		/* distances from root, indexed by cell id */
   int *frontier;	/* cells to check when looking for a target */
+  int *nextfrontier;	/* cells to check after those, swapped each level */
+  int fsize;		/* room in each frontier, compact maps grow them */
+  int *parent;		/* cell each was reached from, see trackparents() */
+  int *buckets;		/* priority queue heads for astarto() */
+  uint64_t *bits;	/* frontier, next and seen bitmaps, hybriddistanceto() */
+  uint64_t *planes;	/* wave and seen bit rows, wavedistanceto() */
+  uint64_t *walls;	/* its copy of east and south links, if not packed */
+  uint16_t *map16;	/* distances when compact, map is NULL until widened */
+  uint64_t *seen;	/* compact maps only, bit set for each cell reached */
+  uint64_t *counts;	/* shortest paths from root to each cell, countpaths() */
+  uint64_t *onpath;	/* bit set for cells on any shortest path to target */
   TRAIL *path;		/* linked list of a path from root to target */
+  int *steps;		/* the same path as an array of cell ids */
+  int pathlen;		/* number of cells in path and steps */
 } DMAP;
 
 
 DMAP *createdistancemap(GRID *, CELL *);
+/* 16 bit distances and a bitmap of cells reached, distanceto() only */
+DMAP *createcompactdistancemap(GRID *, CELL *);
 void freedistancemap(DMAP *);
 
+/* distance to a cell, or NOT_VISITED; compact maps need this */
+int distanceofid(DMAP *, int /*id*/);
+
+/* reuse a distance map on the same grid from a new root, no mallocs */
+int resetdistancemap(DMAP *, CELL *);
+int resetdistancemapbyid(DMAP *, int /*id*/);
+
+/* record parents during floods, making findpath() one pass */
+int trackparents(DMAP *);
+
 int distanceto(DMAP *, CELL *,int /* lazy flag */);
+/* by id, no syncgrid(), safe for threads with a DMAP each */
+int distancetobyid(DMAP *, int /*id*/, int /* lazy flag */);
+/* distanceto() that goes bottom up while the frontier is large */
+int hybriddistanceto(DMAP *, CELL *,int /* lazy flag */);
+/* distanceto() moving the wave 64 cells at a time over bit rows.
+ * Grids not GRID_PACKED have their links copied to bit rows on the
+ * first call, kept with the map and not looked at again: change the
+ * grid, use a new map. Links are taken to be two way; packed grids
+ * with one way links are left to distanceto().
+ */
+int wavedistanceto(DMAP *, CELL *,int /* lazy flag */);
+int astarto(DMAP *, CELL *);
+/* distanceto() by summed cell weights, see setweightbyid() */
+int weighteddistanceto(DMAP *, CELL *,int /* lazy flag */);
+int bidistanceto(DMAP *, CELL *);
 int findpath(DMAP *);
+/* all shortest paths to the target: counts[target_id] has how many,
+ * onanypath() says which cells they use
+ */
+int countpaths(DMAP *);
+int onanypath(DMAP *, int /*id*/);
+/* longest path, map filled from its first cell for every cell */
 DMAP *findlongestpath(GRID *);
 
+/* longest path of a perfect maze in one pass, NULL if it has loops;
+ * only cells on the path are in the map
+ */
+DMAP *findtreediameter(GRID *);
+
+/* longest path of any grid, exact, in a few floods most of the time,
+ * NULL if a flood fails
+ */
+DMAP *findexactlongestpath(GRID *);
+
 int iteratewalk(DMAP *, int(*)(DMAP *, int, void*), void*);
 int namepath(DMAP *, char */*first*/, char */*middle*/, char*/*last*/);
 
 void ascii_dmap(DMAP *);
+
+/* for searches over graphs of cells: steps between two cell ids with
+ * no walls in the way, and a binary heap of keys and ids in two
+ * arrays, smallest key first, len the count in it
+ */
+int manhattan(GRID *, int /*id*/, int /*id*/);
+void heappush(int */*keys*/, int */*ids*/, int */*len*/,
+		int /*key*/, int /*id*/);
+int heappop(int */*keys*/, int */*ids*/, int */*len*/);
 #endif
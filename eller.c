@@ -0,0 +1,54 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+
+/* Eller's algorithm maze, streamed to stdout one row at a time
+ * without ever holding a grid, so it can be as tall as you like.
+ * Optional arguments are rows and columns; zero rows runs forever.
+ *
+ * Example maze:
+ *
+ * +---+---+---+---+---+---+---+---+---+---+
+ * |       |                   |   |       |
+ * +   +---+   +---+   +   +---+   +---+   +
+ * |   |       |       |       |   |   |   |
+ * +   +   +   +   +---+---+---+   +   +   +
+ * |   |   |   |       |                   |
+ * +   +   +---+---+   +---+   +---+   +---+
+ * |   |       |   |   |           |       |
+ * +   +   +---+   +---+   +   +   +---+   +
+ * |   |       |       |   |   |   |       |
+ * +   +   +---+---+   +---+---+   +   +---+
+ * |       |   |   |   |       |   |   |   |
+ * +---+   +   +   +   +---+   +   +   +   +
+ * |   |       |   |   |       |   |   |   |
+ * +   +   +   +   +   +---+   +   +   +   +
+ * |       |                       |   |   |
+ * +   +   +---+   +---+   +   +---+---+   +
+ * |   |   |           |   |       |   |   |
+ * +---+   +---+   +---+   +---+   +   +   +
+ * |           |       |       |           |
+ * +---+---+---+---+---+---+---+---+---+---+
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "mazes.h"
+
+int
+main(int argc, char**argv)
+{
+  int rows = 10;
+  int cols = 10;
+
+  if(argc > 1) { rows = atoi(argv[1]); }
+  if(argc > 2) { cols = atoi(argv[2]); }
+
+  srandom(time(NULL));
+  if(eller(rows, cols, ellerascii, stdout)) {
+    printf("Um, issue.\n");
+    return 1;
+  }
+  return 0;
+}
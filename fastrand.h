@@ -0,0 +1,40 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+/* small fast random number streams, for generators that need lots */
+
+#ifndef _FASTRAND_H
+#define _FASTRAND_H
+
+#include <stdint.h>
+
+/* xorshift64* (Vigna), state must never be 0 */
+static inline uint64_t
+fastrand(uint64_t *state)
+{
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545F4914F6CDD1DULL;
+} /* fastrand() */
+
+/* 0 to n-1 from fastrand(), by multiply and shift rather than modulo */
+static inline uint32_t
+fastbelow(uint64_t *state, uint32_t n)
+{
+  return (uint32_t)(((fastrand(state) >> 32) * n) >> 32);
+} /* fastbelow() */
+
+/* First state of stream k of a seed: splitmix64 of the two, so
+ * streams are unrelated and any one can be started on its own.
+ */
+static inline uint64_t
+faststream(uint64_t seed, int k)
+{
+  uint64_t z = seed + (uint64_t)(k + 1) * 0x9E3779B97F4A7C15ULL;
+
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z ^= z >> 31;
+  return z ? z : 1;
+} /* faststream() */
+
+#endif
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
+#include <assert.h>
 
 #include "grid.h"
 
@@ -39,8 +40,220 @@ freecell(CELL *c)
   if(c->data) { free(c->data); }
 } /* freecell() */
 
+/* Grids in the GRID_PACKED layout have no array of CELLs. A 2D
+ * perfect maze only needs to know if each cell opens to the east
+ * and to the south, so those are kept as two bitplanes (rows padded
+ * out to whole uint64_t words) and ctype is kept as one byte. Names
+ * and data pointers go in side tables allocated on first use.
+ *
+ * visit functions hand out pointers into a small set of views, CELL
+ * structs filled in from the compact storage. Views act as a write
+ * back cache: connectbycell(), namebycell() and changes to ctype made
+ * through a CELL pointer land in the view and are copied to storage
+ * when the view is reused or syncgrid() is called. The least recently
+ * used view is the one reused, so a CELL pointer stays good until
+ * GRID_VIEWS other cells have been visited since it was last used.
+ *
+ * Only connections to adjacent cells can be stored. While every link
+ * is two way, a cell's west and north links are its neighbors' east
+ * and south bits. The first one way link (from connectbyid(), or a
+ * view written back that disagrees with its neighbor) gives west and
+ * north bitplanes of their own, so links read back as they were made.
+ *
+ * Grids in the GRID_SPLIT layout keep the same information as CELLs,
+ * but as separate arrays: FOURDIRECTIONS links per cell, an int ctype
+ * per cell, and the same lazy name and data side tables. Row and col
+ * are worked out from the id. They use views the same way.
+ */
+
+/* where a cell lives in a bitplane */
+#define BITWORD(g,id)	((g)->words * ((id) / (g)->cols) + ((id) % (g)->cols) / 64)
+#define BITMASK(g,id)	((uint64_t)1 << (((id) % (g)->cols) % 64))
+
+static int
+getbit(GRID *g, uint64_t *plane, int id)
+{
+  return (plane[BITWORD(g,id)] & BITMASK(g,id)) != 0;
+}
+
+static void
+setbit(GRID *g, uint64_t *plane, int id)
+{
+  plane[BITWORD(g,id)] |= BITMASK(g,id);
+}
+
+static void
+clearbit(GRID *g, uint64_t *plane, int id)
+{
+  plane[BITWORD(g,id)] &= ~BITMASK(g,id);
+}
+
+/* the plane and id a cell's link in direction d is kept under */
+static uint64_t *
+linkplane(GRID *g, int id, int d, int *at)
+{
+  switch(d) {
+    case EAST:  *at = id; return g->east;
+    case SOUTH: *at = id; return g->south;
+    case WEST:  *at = id - 1; return g->west ? g->west : g->east;
+    case NORTH: *at = id - g->cols; return g->north ? g->north : g->south;
+  }
+  return (uint64_t*)NULL;
+} /* linkplane() */
+
+/* a one way link is coming: west and north get planes of their own,
+ * starting as copies of east and south. Returns 0, or -1 if out of
+ * memory.
+ */
+static int
+splitplanes(GRID *g)
+{
+  size_t size = (size_t)g->rows * g->words * sizeof(uint64_t);
+
+  if(g->west) { return 0; }
+  g->west = (uint64_t*)malloc(size);
+  g->north = (uint64_t*)malloc(size);
+  if(!g->west || !g->north) {
+    if(g->west) { free(g->west); }
+    if(g->north) { free(g->north); }
+    g->west = g->north = (uint64_t*)NULL;
+    return -1;
+  }
+  memcpy(g->west, g->east, size);
+  memcpy(g->north, g->south, size);
+  return 0;
+} /* splitplanes() */
+
+static CELL *findview(GRID *, int);
+
+/* copy a view back to compact storage */
+static void
+storeview(GRID *g, CELL *v)
+{
+  int id = v->id;
+
+  if(id == NC) { return; }
+
+  if(g->layout == GRID_SPLIT) {
+    g->ctypes[id] = v->ctype;
+    for(int d = FIRSTDIR; d < FOURDIRECTIONS; d++) {
+      g->links[id * FOURDIRECTIONS + d] = v->dir[d];
+    }
+  } else {
+    g->ctype8[id] = (unsigned char)v->ctype;
+
+    /* each link as the view has it, set or cleared */
+    for(int d = FIRSTDIR; d < FOURDIRECTIONS; d++) {
+      int n = nextid(g, id, d), want = (v->dir[d] != NC), at, back;
+      uint64_t *plane;
+      CELL *nv;
+
+      if(n == NC) { continue; }
+      plane = linkplane(g, id, d, &at);
+      if(getbit(g, plane, at) == want) { continue; }
+
+      /* a shared bit is the neighbor's link back too */
+      if(!g->west) {
+	nv = findview(g, n);
+	back = nv ? (nv->dir[opposite(d)] != NC) : !want;
+	if((back != want) && splitplanes(g)) { continue; }
+	plane = linkplane(g, id, d, &at);
+      }
+      if(want) { setbit(g, plane, at); } else { clearbit(g, plane, at); }
+    }
+  }
+
+  if(v->name && !g->names) {
+    g->names = (char **)calloc((size_t)g->max, sizeof(char *));
+  }
+  if(g->names) { g->names[id] = v->name; }
+
+  if(v->data && !g->datas) {
+    g->datas = (void **)calloc((size_t)g->max, sizeof(void *));
+  }
+  if(g->datas) { g->datas[id] = v->data; }
+} /* storeview() */
+
+/* fill a view from compact storage */
+static void
+loadview(GRID *g, CELL *v, int id)
+{
+  int i = id / g->cols;
+  int j = id % g->cols;
+
+  if(g->layout == GRID_SPLIT) {
+    initcell(v, g->ctypes[id], i, j, id);
+    for(int d = FIRSTDIR; d < FOURDIRECTIONS; d++) {
+      v->dir[d] = g->links[id * FOURDIRECTIONS + d];
+    }
+  } else {
+    initcell(v, g->ctype8[id], i, j, id);
+
+    for(int d = FIRSTDIR; d < FOURDIRECTIONS; d++) {
+      int n = nextid(g, id, d), at;
+      uint64_t *plane = linkplane(g, id, d, &at);
+
+      if((n != NC) && getbit(g, plane, at)) { v->dir[d] = n; }
+    }
+  }
+
+  v->name = g->names ? g->names[id] : NULL;
+  v->data = g->datas ? g->datas[id] : NULL;
+} /* loadview() */
+
+/* find or make the view of cell id */
+static CELL *
+viewid(GRID *g, int id)
+{
+  int v, old = 0;
+
+  for(v = 0; v < GRID_VIEWS; v++) {
+    if(g->views[v].id == id) {
+      g->viewstamp[v] = ++ g->viewclock;
+      return &(g->views[v]);
+    }
+    if(g->viewstamp[v] < g->viewstamp[old]) { old = v; }
+  }
+
+  storeview(g, &(g->views[old]));
+  loadview(g, &(g->views[old]), id);
+  g->viewstamp[old] = ++ g->viewclock;
+  return &(g->views[old]);
+} /* viewid() */
+
+/* the view of cell id, if there is one, without making one */
+static CELL *
+findview(GRID *g, int id)
+{
+  for(int v = 0; v < GRID_VIEWS; v++) {
+    if(g->views[v].id == id) {
+      return &(g->views[v]);
+    }
+  }
+  return (CELL*)NULL;
+} /* findview() */
+
+/* Mark a cell as recently used, if it is a view. id is the cell the
+ * caller believes it has; debug builds check the view still holds it,
+ * catching a CELL pointer kept past GRID_VIEWS other visits.
+ */
+static void
+touchview(GRID *g, CELL *c, int id)
+{
+  if(g->views && (c >= g->views) && (c < g->views + GRID_VIEWS)) {
+    assert(c->id == id);
+    g->viewstamp[c - g->views] = ++ g->viewclock;
+  }
+} /* touchview() */
+
 GRID*
 creategrid(int i, int j, int t)
+{
+  return creategridlayout(i, j, t, GRID_CELLS);
+} /* creategrid() */
+
+GRID*
+creategridlayout(int i, int j, int t, int layout)
 {
   GRID *g;
   CELL *c;
@@ -49,6 +262,10 @@ creategrid(int i, int j, int t)
   if((i < 1) || (j < 1)) {
     return (GRID*)NULL;
   }
+  if((layout != GRID_CELLS) && (layout != GRID_PACKED) &&
+     (layout != GRID_SPLIT)) {
+    return (GRID*)NULL;
+  }
   
   g = (GRID*)calloc(1, sizeof(GRID));
   if(!g) { return g; }
@@ -59,14 +276,57 @@ creategrid(int i, int j, int t)
   g->planes = 1;	/* up/down later */
   g->gtype = t;
   g->max = count;
+  g->layout = layout;
+
+  srandom(time(NULL));
+
+  if(layout != GRID_CELLS) {
+    g->views = (CELL*)calloc(GRID_VIEWS, sizeof(CELL));
+    g->viewstamp = (unsigned long*)calloc(GRID_VIEWS, sizeof(unsigned long));
+    if(!g->views || !g->viewstamp) {
+      freegrid(g);
+      return (GRID*)NULL;
+    }
+    for(int v = 0; v < GRID_VIEWS; v++) {
+      g->views[v].id = NC;
+    }
+  }
+
+  if(layout == GRID_PACKED) {
+    g->words = (j + 63) / 64;
+    g->east = (uint64_t*)calloc((size_t)i * g->words, sizeof(uint64_t));
+    g->south = (uint64_t*)calloc((size_t)i * g->words, sizeof(uint64_t));
+    g->ctype8 = (unsigned char*)malloc((size_t)count);
+    if(!g->east || !g->south || !g->ctype8) {
+      freegrid(g);
+      return (GRID*)NULL;
+    }
+    memset(g->ctype8, (unsigned char)t, (size_t)count);
+    return g;
+  }
+
+  if(layout == GRID_SPLIT) {
+    g->links = (int*)malloc((size_t)count * FOURDIRECTIONS * sizeof(int));
+    g->ctypes = (int*)malloc((size_t)count * sizeof(int));
+    if(!g->links || !g->ctypes) {
+      freegrid(g);
+      return (GRID*)NULL;
+    }
+    for(int m = 0; m < count; m++) {
+      for(int d = 0; d < FOURDIRECTIONS; d++) {
+        g->links[m * FOURDIRECTIONS + d] = NC;
+      }
+      g->ctypes[m] = t;
+    }
+    return g;
+  }
+
   g->cells = (CELL*)calloc((size_t)count, sizeof(CELL));
   if(!g->cells) {
     free(g);
     return (GRID*)NULL;
   }
 
-  srandom(time(NULL));
-
   count = 0;
   for (int row = 0; row < g->rows; row ++) {
     for (int col = 0; col < g->cols; col ++) {
@@ -77,7 +337,18 @@ creategrid(int i, int j, int t)
   }
 
   return g;
-} /* creategrid() */
+} /* creategridlayout() */
+
+/* write all views back to storage, they stay valid */
+void
+syncgrid(GRID *g)
+{
+  if(!g || !g->views) { return; }
+
+  for(int v = 0; v < GRID_VIEWS; v++) {
+    storeview(g, &(g->views[v]));
+  }
+} /* syncgrid() */
 
 void
 freegrid(GRID* g)
@@ -97,6 +368,31 @@ freegrid(GRID* g)
     free(g->cells);
   }
 
+  /* views share name and data pointers with the side tables */
+  syncgrid(g);
+  if(g->names) {
+    for(i = 0; i < g->max; i++) {
+      if(g->names[i]) { free(g->names[i]); }
+    }
+    free(g->names);
+  }
+  if(g->datas) {
+    for(i = 0; i < g->max; i++) {
+      if(g->datas[i]) { free(g->datas[i]); }
+    }
+    free(g->datas);
+  }
+  if(g->east) { free(g->east); }
+  if(g->south) { free(g->south); }
+  if(g->west) { free(g->west); }
+  if(g->north) { free(g->north); }
+  if(g->ctype8) { free(g->ctype8); }
+  if(g->links) { free(g->links); }
+  if(g->ctypes) { free(g->ctypes); }
+  if(g->weights) { free(g->weights); }
+  if(g->views) { free(g->views); }
+  if(g->viewstamp) { free(g->viewstamp); }
+
   free(g);
 } /* freegrid() */
 
@@ -113,6 +409,7 @@ visitrc(GRID *g, int i, int j)
   }
 
   index = (g->cols * i) + j;
+  if(g->views) { return viewid(g, index); }
   return &(g->cells[index]);
 } /* visit() */
 
@@ -124,10 +421,11 @@ visitid(GRID *g, int id)
     return (CELL*)NULL;
   }
 
-  if(id > g->max) {
+  if(id >= g->max) {
     return (CELL*)NULL;
   }
 
+  if(g->views) { return viewid(g, id); }
   return &(g->cells[id]);
 } /* visitid() */
 
@@ -167,7 +465,7 @@ visitdir(GRID *g, CELL *c, int d, int cs)
   }
 
   /* off grid in any way? */
-  if((id < 0) || (id > g->max) || (ni < 0) || (nj < 0) ||
+  if((id < 0) || (id >= g->max) || (ni < 0) || (nj < 0) ||
      (ni >= g->rows) || (nj >= g->cols)) {
     return (CELL*)NULL;
   }
@@ -176,7 +474,8 @@ visitdir(GRID *g, CELL *c, int d, int cs)
    * connection status criteria?
    */
 
-  CELL *that = &(g->cells[id]);
+  touchview(g, c, (g->cols * i) + j);
+  CELL *that = visitid(g, id);
 
   /* don't care about connection */
   if(cs == ANY) {
@@ -218,6 +517,122 @@ visitrandom(GRID *g)
   return visitid(g, random() % g->max);
 }
 
+/* id level access, for loops that only need connectivity or ctype
+ * and want to skip CELL structs. On layouts other than GRID_CELLS
+ * these read and write the compact storage directly, so changes made
+ * through CELL pointers are only seen after a syncgrid().
+ */
+
+/* the id of the cell in direction d from cell id, or NC if off grid */
+int
+nextid(GRID *g, int id, int d)
+{
+  int i, j;
+
+  if(!g || (id < 0) || (id >= g->max)) { return NC; }
+
+  i = id / g->cols;
+  j = id % g->cols;
+
+  switch(d) {
+    case NORTH: return (i > 0)           ? id - g->cols : NC;
+    case SOUTH: return (i < g->rows - 1) ? id + g->cols : NC;
+    case WEST:  return (j > 0)           ? id - 1 : NC;
+    case EAST:  return (j < g->cols - 1) ? id + 1 : NC;
+    default:    return NC;
+  }
+} /* nextid() */
+
+/* the id cell id connects to in direction d, or NC */
+int
+linkbyid(GRID *g, int id, int d)
+{
+  uint64_t *plane;
+  int n, at;
+
+  if(!g || (id < 0) || (id >= g->max)) { return NC; }
+  if((d < FIRSTDIR) || (d >= DIRECTIONS)) { return NC; }
+
+  if(g->layout == GRID_CELLS) {
+    return g->cells[id].dir[d];
+  }
+  if(d >= FOURDIRECTIONS) { return NC; }
+
+  if(g->layout == GRID_SPLIT) {
+    return g->links[id * FOURDIRECTIONS + d];
+  }
+
+  n = nextid(g, id, d);
+  if(n == NC) { return NC; }
+  plane = linkplane(g, id, d, &at);
+  return getbit(g, plane, at) ? n : NC;
+} /* linkbyid() */
+
+/* ctype of a cell, NC if no such cell */
+int
+ctypebyid(GRID *g, int id)
+{
+  if(!g || (id < 0) || (id >= g->max)) { return NC; }
+
+  switch(g->layout) {
+    case GRID_SPLIT:  return g->ctypes[id];
+    case GRID_PACKED: return g->ctype8[id];
+    default:          return g->cells[id].ctype;
+  }
+} /* ctypebyid() */
+
+void
+setctypebyid(GRID *g, int id, int t)
+{
+  CELL *v;
+
+  if(!g || (id < 0) || (id >= g->max)) { return; }
+
+  switch(g->layout) {
+    case GRID_SPLIT:  g->ctypes[id] = t; break;
+    case GRID_PACKED: g->ctype8[id] = (unsigned char)t; break;
+    default:          g->cells[id].ctype = t; return;
+  }
+  if((v = findview(g, id))) { v->ctype = t; }
+} /* setctypebyid() */
+
+/* name of a cell, NULL if none */
+char *
+getnamebyid(GRID *g, int id)
+{
+  if(!g || (id < 0) || (id >= g->max)) { return NULL; }
+
+  if(g->layout == GRID_CELLS) {
+    return g->cells[id].name;
+  }
+  return g->names ? g->names[id] : NULL;
+} /* getnamebyid() */
+
+/* cost of entering a cell, NC if no such cell */
+int
+weightbyid(GRID *g, int id)
+{
+  if(!g || (id < 0) || (id >= g->max)) { return NC; }
+
+  return g->weights ? g->weights[id] : 1;
+} /* weightbyid() */
+
+int
+setweightbyid(GRID *g, int id, int w)
+{
+  if(!g || (id < 0) || (id >= g->max)) { return -1; }
+  if((w < 0) || (w > GRID_MAXWEIGHT)) { return -1; }
+
+  if(!g->weights) {
+    if(w == 1) { return 0; }
+    g->weights = (unsigned char*)malloc((size_t)g->max);
+    if(!g->weights) { return -1; }
+    memset(g->weights, 1, (size_t)g->max);
+  }
+  g->weights[id] = (unsigned char)w;
+  return 0;
+} /* setweightbyid() */
+
 /* {FOO}bycell functions use one or two CELL pointers
  * {FOO}byrc functions take GRID and one or two pairs of row,col
  * {FOO}byid functions take GRID and one or two ids
@@ -261,12 +676,65 @@ void connectbyrc(GRID *g, int r1, int c1, int c1c2d,
                 visitrc(g, r2, c2), c2c1d);
 } /* connectbyrc() */
 
+/* write one direction of a connection straight to compact storage,
+ * keeping any view of the cell in step
+ */
+static void
+storelink(GRID *g, int id1, int d, int id2)
+{
+  CELL *v;
+
+  if(g->layout == GRID_SPLIT) {
+    if(d >= FOURDIRECTIONS) { return; }
+    g->links[id1 * FOURDIRECTIONS + d] = id2;
+  } else {
+    uint64_t *plane;
+    int at;
+
+    if(d >= FOURDIRECTIONS) { return; }
+    plane = linkplane(g, id1, d, &at);
+    setbit(g, plane, at);
+  }
+  if((v = findview(g, id1))) { v->dir[d] = id2; }
+} /* storelink() */
+
 void connectbyid(GRID *g, int id1, int c1c2d,
                           int id2, int c2c1d)
 {
   if(!g) { return; }
-  connectbycell(visitid(g, id1), c1c2d,
-                visitid(g, id2), c2c1d);
+
+  if(g->layout == GRID_CELLS) {
+    connectbycell(visitid(g, id1), c1c2d,
+                  visitid(g, id2), c2c1d);
+    return;
+  }
+
+  /* same checks as connectbycell() */
+  if((id1 < 0) || (id1 >= g->max)) { return; }
+  if((id2 < 0) || (id2 >= g->max)) { return; }
+
+  if(c2c1d == SYMMETRICAL) { c2c1d = opposite(c1c2d); }
+
+  if(c1c2d >= DIRECTIONS) { return; }
+  if(c2c1d >= DIRECTIONS) { return; }
+  if(c1c2d < NC) { return; }
+  if(c2c1d < NC) { return; }
+
+  /* packed bits are shared by both ways until a link is one way */
+  if((g->layout == GRID_PACKED) && !g->west &&
+     !((c1c2d > NC) && (c2c1d == opposite(c1c2d))) &&
+     (((c1c2d > NC) && (linkbyid(g, id1, c1c2d) == NC)) ||
+      ((c2c1d > NC) && (linkbyid(g, id2, c2c1d) == NC))) &&
+     splitplanes(g)) {
+    return;
+  }
+
+  if(c1c2d > NC) {
+    storelink(g, id1, c1c2d, id2);
+  }
+  if(c2c1d > NC) {
+    storelink(g, id2, c2c1d, id1);
+  }
 } /* connectbyid() */
 
 
@@ -324,20 +792,27 @@ isconnectedbyid(GRID *g, int id1, int id2, int d)
  * adjoins. Edges are returned as bit status flags, so check
  * results accordingly.
  */
+static int
+edgestatus(GRID *g, int i, int j)
+{
+  int edges = 0;
+
+  if(i == 0) {           edges = edges|NORTH_EDGE; }
+  if(j == 0) {           edges = edges|WEST_EDGE; }
+  if(i == g->rows - 1) { edges = edges|SOUTH_EDGE; }
+  if(j == g->cols - 1) { edges = edges|EAST_EDGE; }
+
+  if (edges == 0) {      edges = NO_EDGES; }
+  return edges;
+} /* edgestatus() */
+
 int
 edgestatusbycell(GRID *g, CELL *c)
 {
-  int edges = 0;
   if(!g) { return EDGE_ERROR; }
   if(!c) { return EDGE_ERROR; }
 
-  if(c->row == 0) {           edges = edges|NORTH_EDGE; }
-  if(c->col == 0) {           edges = edges|WEST_EDGE; }
-  if(c->row == g->rows - 1) { edges = edges|SOUTH_EDGE; }
-  if(c->col == g->cols - 1) { edges = edges|EAST_EDGE; }
-
-  if (edges == 0) {           edges = NO_EDGES; }
-  return edges;
+  return edgestatus(g, c->row, c->col);
 } /* edgestatusbycell() */
 
 int
@@ -348,12 +823,14 @@ edgestatusbyrc(GRID *g, int i, int j)
   return edgestatusbycell(g, visitrc(g,i,j));
 } /* edgestatusbyrc */
 
+/* works from the id alone, without visiting the cell */
 int
 edgestatusbyid(GRID *g, int id)
 {
   if(!g) { return EDGE_ERROR; }
+  if((id < 0) || (id >= g->max)) { return EDGE_ERROR; }
 
-  return edgestatusbycell(g, visitid(g,id));
+  return edgestatus(g, id / g->cols, id % g->cols);
 } /* edgestatusbyid */
 
 
@@ -538,7 +1015,8 @@ ascii_grid(GRID *g, int use_name)
   char *out = NULL;
   int i, j, p, outsize;
   char left, top;
-  CELL *here, *west, *north;
+  char *name;
+  int here;
   
   if(!g) { return out; }
 
@@ -554,10 +1032,13 @@ ascii_grid(GRID *g, int use_name)
   if(use_name && g->name) {
     p = 1 + strnlen(g->name, BUFSIZ);
     use_name += p;
+    outsize += p;
   }
   out = (char*) malloc(outsize);
   if(!out) { return out; }
 
+  syncgrid(g);
+
   if(use_name && g->name) {
     strncpy(out, g->name, p);
     /* replace the final null */
@@ -569,11 +1050,10 @@ ascii_grid(GRID *g, int use_name)
       for(j = 0; j < g->cols; j ++) { /* grid col */
         left = '|';
         top = '-';
-	here = visitrc(g,i,j);
+	here = (g->cols * i) + j;
 
         if(i) {
-	  north = visitrc(g,i-1,j);
-	  if(isconnectedbycell(here, north, NORTH) != NC) {
+	  if(linkbyid(g, here, NORTH) == here - g->cols) {
 	    top = ' ';
 	  } else {
             top = '-';
@@ -581,8 +1061,7 @@ ascii_grid(GRID *g, int use_name)
 	}
 
         if(j) {
-	  west = visitrc(g,i,j-1);
-	  if(isconnectedbycell(west, here, EAST) != NC) {
+	  if(linkbyid(g, here - 1, EAST) == here) {
 	    left = ' ';
 	  } else {
 	    left = '|';
@@ -591,8 +1070,9 @@ ascii_grid(GRID *g, int use_name)
 
         if(l) {
 	  out[p++] =left;
-	  if(use_name && here->name) {
-	    char *s = here->name;
+	  name = use_name ? getnamebyid(g, here) : NULL;
+	  if(name) {
+	    char *s = name;
 	    if(*s) { out[p++] = *s; s++; } else { out[p++] = ' '; }
 	    if(*s) { out[p++] = *s; s++; } else { out[p++] = ' '; }
 	    if(*s) { out[p++] = *s; s++; } else { out[p++] = ' '; }
@@ -4,6 +4,8 @@
 #ifndef _GRID_H
 #define _GRID_H
 
+#include <stdint.h>
+
 #define DIRECTIONS      6
 #define FOURDIRECTIONS  4	/* without up / down */
 #define FIRSTDIR        0
@@ -48,6 +50,23 @@
 #define NO_WALLS	0x200
 #define WALL_ERROR	EDGE_ERROR
 
+/* storage layouts, for creategridlayout() */
+#define GRID_CELLS	0	/* an array of CELL structs, the default */
+#define GRID_PACKED	1	/* walls as bitplanes, ctype as a byte */
+#define GRID_SPLIT	2	/* links, ctype, names and data in own arrays */
+
+/* heaviest cell cost, see setweightbyid() */
+#define GRID_MAXWEIGHT	255
+
+/* How many cells a non-GRID_CELLS grid keeps as CELL structs at once.
+ * On those layouts a CELL pointer from a visit function is one of
+ * these views, and it is only good until GRID_VIEWS other cells have
+ * been visited. After that the same pointer is a different cell, and
+ * writing through it changes that cell. Don't hold more than this
+ * many CELL pointers at a time; keep ids and visit again instead.
+ */
+#define GRID_VIEWS	16
+
 /* Max size of a name */
 #ifndef BUFSIZ
 #  define BUFSIZ 1024	/* typical value from stdio.h */
@@ -83,22 +102,71 @@ typedef struct
    char *name;	/* for user use */
    void *data;	/* for user use to hold arbitrary structures */
 
-   CELL *cells;
+   int layout;	/* storage layout, set at creation time */
+
+   CELL *cells;	/* GRID_CELLS storage */
+
+   /* GRID_PACKED storage; cells are reached through views, see grid.c */
+   int words;		/* uint64_t words per row of a bitplane */
+   uint64_t *east;	/* bit set if a cell connects east */
+   uint64_t *south;	/* bit set if a cell connects south */
+   uint64_t *west;	/* bit set if a cell's east neighbor connects back */
+   uint64_t *north;	/* and south neighbor; both NULL until a one way link */
+   unsigned char *ctype8;	/* ctype of each cell, clipped to a byte */
+
+   /* GRID_SPLIT storage; also reached through views */
+   int *links;		/* FOURDIRECTIONS connections per cell */
+   int *ctypes;		/* ctype of each cell */
+
+   /* shared by GRID_PACKED and GRID_SPLIT */
+   char **names;	/* cell names, allocated on first use */
+   void **datas;	/* cell data, allocated on first use */
+   CELL *views;		/* recently visited cells */
+   unsigned long *viewstamp;
+   unsigned long viewclock;
+
+   /* any layout */
+   unsigned char *weights;	/* cell costs, allocated on first use */
 } GRID;
 
 void initcell(CELL*, int /*ctype*/, int /*i*/, int/*j*/, int /*id*/);
 void freecell(CELL*);
 
 GRID *creategrid(int /*rows*/, int /*cols*/, int /*gtype*/);
+GRID *creategridlayout(int /*rows*/, int /*cols*/, int /*gtype*/, int /*layout*/);
 void freegrid(GRID *);
 
+/* copy changes made through CELL pointers back to compact storage */
+void syncgrid(GRID *);
 
-/* visit functions return a CELL pointer */
+
+/* visit functions return a CELL pointer; on GRID_PACKED and
+ * GRID_SPLIT grids it is a view, good for GRID_VIEWS more visits
+ */
 CELL *visitrc(GRID *, int /*rows*/, int /*cols*/);
 CELL *visitid(GRID *, int /*cellid*/);
 CELL *visitdir(GRID *, CELL */*cell*/, int/*direction*/, int/* connection status */);
 CELL *visitrandom(GRID *);
 
+/* id level access for hot loops, no CELL structs involved.
+ * nextid gives the id of the neighbor in a direction, linkbyid the
+ * id a cell connects to in a direction; both NC if none.
+ * On layouts other than GRID_CELLS these use storage directly, so
+ * syncgrid() first if cells were changed through CELL pointers.
+ */
+int nextid(GRID *, int /*id*/, int /*direction*/);
+int linkbyid(GRID *, int /*id*/, int /*direction*/);
+int ctypebyid(GRID *, int /*id*/);
+void setctypebyid(GRID *, int /*id*/, int /*ctype*/);
+char *getnamebyid(GRID *, int /*id*/);
+
+/* cost of entering a cell, 0 to GRID_MAXWEIGHT, for weighteddistanceto().
+ * Every cell costs 1 until a weight is set. setweightbyid returns 0,
+ * or -1 for a bad cell or weight, or a failed malloc.
+ */
+int weightbyid(GRID *, int /*id*/);
+int setweightbyid(GRID *, int /*id*/, int /*weight*/);
+
 
 /* bycell functions use one or two CELL pointers
  * byrc functions take GRID and one or two pairs of row,col
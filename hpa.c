@@ -0,0 +1,568 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+/* hierarchical (HPA*) index for solving very large mazes, needs -pthread */
+
+/* for pthreads under -std=c99 */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "grid.h"
+#include "distance.h"
+#include "parallel.h"
+#include "hpa.h"
+
+#define HPA_FAR		0x7fffffff	/* not reached */
+#define HPA_MAGIC	"HPA2"
+
+/* which cluster a cell is in */
+static int
+clusterof(HPA *h, int id)
+{
+  int r = id / h->grid->cols;
+  int c = id % h->grid->cols;
+
+  return (r / h->csize) * h->ccols + c / h->csize;
+} /* clusterof() */
+
+/* index of a cell within its cluster's work arrays */
+static int
+localof(HPA *h, int id)
+{
+  return (id / h->grid->cols % h->csize) * h->csize +
+  	 (id % h->grid->cols % h->csize);
+} /* localof() */
+
+/* Flood from a cell without leaving its cluster. dist and prev are
+ * indexed by localof(), queue is scratch; all csize squared.
+ */
+static void
+clusterflood(HPA *h, int from, int *dist, int *prev, int *queue)
+{
+  int k = clusterof(h, from);
+  int head = 0, tail = 0, u, v, lv;
+
+  for(int i = 0; i < h->csize * h->csize; i ++) { dist[i] = NV; }
+
+  lv = localof(h, from);
+  dist[lv] = 0;
+  prev[lv] = NC;
+  queue[tail++] = from;
+
+  while(head < tail) {
+    u = queue[head++];
+    for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+      v = linkbyid(h->grid, u, go);
+      if((v == NC) || (clusterof(h, v) != k)) { continue; }
+      lv = localof(h, v);
+      if(dist[lv] != NV) { continue; }
+      dist[lv] = dist[localof(h, u)] + 1;
+      prev[lv] = u;
+      queue[tail++] = v;
+    }
+  }
+} /* clusterflood() */
+
+/* portal number of a cell in cluster k, NC if it isn't one */
+static int
+findportal(HPA *h, int k, int id)
+{
+  int lo = h->cfirst[k], hi = h->cfirst[k+1] - 1, mid;
+
+  while(lo <= hi) {
+    mid = (lo + hi) / 2;
+    if(h->node[mid] == id) { return mid; }
+    if(h->node[mid] < id) { lo = mid + 1; } else { hi = mid - 1; }
+  }
+  return NC;
+} /* findportal() */
+
+/* connections of a cell that leave its cluster */
+static int
+crossings(HPA *h, int id)
+{
+  int v, n = 0;
+
+  for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+    v = linkbyid(h->grid, id, go);
+    if((v != NC) && (clusterof(h, v) != clusterof(h, id))) { n ++; }
+  }
+  return n;
+} /* crossings() */
+
+/* the query work space, also used by createhpa() and loadhpa() */
+static int
+allocwork(HPA *h)
+{
+  int area = h->csize * h->csize;
+
+  h->dist = malloc( (h->nodes + 1) * sizeof(int) );
+  h->pnode = malloc( (h->nodes + 1) * sizeof(int) );
+  h->stamp = calloc( h->nodes + 1, sizeof(int) );
+  h->heapf = malloc( (h->ends + h->nodes + 1) * sizeof(int) );
+  h->heapn = malloc( (h->ends + h->nodes + 1) * sizeof(int) );
+  h->local = malloc( 7 * area * sizeof(int) );
+  if(!h->dist || !h->pnode || !h->stamp || !h->heapf || !h->heapn ||
+     !h->local) {
+    return 1;
+  }
+  h->query = 0;
+  h->popped = 0;
+  return 0;
+} /* allocwork() */
+
+/* shared state of a createhpa() build */
+typedef struct {
+  HPA *h;
+  int taken;		/* clusters handed out so far */
+} HBUILD;
+
+/* one builder thread, with its own flood arrays */
+typedef struct {
+  HBUILD *hb;
+  int *work;
+} HWORKER;
+
+/* fill in the links of every portal, a cluster at a time */
+static void *
+buildworker(void *arg)
+{
+  HWORKER *hw = (HWORKER *)arg;
+  HPA *h = hw->hb->h;
+  int area = h->csize * h->csize;
+  int *dist = hw->work, *prev = dist + area, *queue = prev + area;
+  int k, e, v;
+
+  while((k = __atomic_fetch_add(&hw->hb->taken, 1, __ATOMIC_RELAXED)) <
+  						h->crows * h->ccols) {
+    for(int n = h->cfirst[k]; n < h->cfirst[k+1]; n ++) {
+      clusterflood(h, h->node[n], dist, prev, queue);
+      e = h->first[n];
+      for(int m = h->cfirst[k]; m < h->cfirst[k+1]; m ++) {
+        if(m == n) { continue; }
+	h->to[e] = m;
+	h->weight[e] = dist[localof(h, h->node[m])];
+	if(h->weight[e] < 0) { h->weight[e] = -1; }
+	e ++;
+      }
+      for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+        v = linkbyid(h->grid, h->node[n], go);
+	if((v == NC) || (clusterof(h, v) == k)) { continue; }
+	h->to[e] = findportal(h, clusterof(h, v), v);
+	h->weight[e] = 1;
+	e ++;
+      }
+    }
+  }
+  return NULL;
+} /* buildworker() */
+
+HPA *
+createhpa(GRID *g, int csize, int threads)
+{
+  HPA *h;
+  HBUILD hb;
+  HWORKER *hw;
+  pthread_t *tids;
+  int *fill, k, n, id, clusters, started;
+
+  if(!g) { return NULL; }
+  if(csize < 1) { csize = HPA_CLUSTER; }
+  if(threads < 1) { threads = defaultthreads(); }
+
+  h = (HPA *)calloc( 1, sizeof(HPA) );
+  if(!h) { return NULL; }
+
+  h->grid = g;
+  h->csize = csize;
+  h->crows = (g->rows + csize - 1) / csize;
+  h->ccols = (g->cols + csize - 1) / csize;
+  clusters = h->crows * h->ccols;
+
+  syncgrid(g);
+
+  /* count portals by cluster, then list them */
+  h->cfirst = calloc( clusters + 1, sizeof(int) );
+  if(!h->cfirst) { freehpa(h); return NULL; }
+  for(id = 0; id < g->max; id ++) {
+    if(crossings(h, id)) { h->cfirst[clusterof(h, id) + 1] ++; }
+  }
+  for(k = 0; k < clusters; k ++) { h->cfirst[k+1] += h->cfirst[k]; }
+  h->nodes = h->cfirst[clusters];
+
+  h->node = malloc( (h->nodes + 1) * sizeof(int) );
+  h->first = malloc( (h->nodes + 1) * sizeof(int) );
+  if(!h->node || !h->first) { freehpa(h); return NULL; }
+
+  /* cells in id order land in each cluster's list in id order */
+  fill = malloc( clusters * sizeof(int) );
+  if(!fill) { freehpa(h); return NULL; }
+  memcpy(fill, h->cfirst, clusters * sizeof(int));
+  for(id = 0; id < g->max; id ++) {
+    if(crossings(h, id)) { h->node[fill[clusterof(h, id)] ++] = id; }
+  }
+  free(fill);
+
+  /* links: every other portal of the cluster, and the crossings */
+  h->ends = 0;
+  for(k = 0; k < clusters; k ++) {
+    for(n = h->cfirst[k]; n < h->cfirst[k+1]; n ++) {
+      h->first[n] = h->ends;
+      h->ends += h->cfirst[k+1] - h->cfirst[k] - 1 + crossings(h, h->node[n]);
+    }
+  }
+  h->first[h->nodes] = h->ends;
+
+  h->to = malloc( (h->ends + 1) * sizeof(int) );
+  h->weight = malloc( (h->ends + 1) * sizeof(int) );
+  if(!h->to || !h->weight || allocwork(h)) { freehpa(h); return NULL; }
+
+  /* clusters are independent from here, share them out */
+  if(threads > clusters) { threads = clusters; }
+  if(threads > PARALLEL_MAXTHREADS) { threads = PARALLEL_MAXTHREADS; }
+  hb.h = h;
+  hb.taken = 0;
+  hw = (HWORKER *)malloc( threads * sizeof(HWORKER) );
+  tids = (pthread_t *)malloc( threads * sizeof(pthread_t) );
+  if(!hw || !tids) {
+    if(hw) { free(hw); }
+    if(tids) { free(tids); }
+    freehpa(h);
+    return NULL;
+  }
+  for(k = 0; k < threads; k ++) {
+    hw[k].hb = &hb;
+    hw[k].work = malloc( 3 * csize * csize * sizeof(int) );
+    if(!hw[k].work) { break; }
+  }
+  threads = k;
+
+  /* the calling thread is worker 0, and makes do if others fail */
+  started = 1;
+  if(threads) {
+    for( ; started < threads; started ++) {
+      if(pthread_create(&tids[started], NULL, buildworker, &hw[started])) {
+	break;
+      }
+    }
+    buildworker(&hw[0]);
+    for(k = 1; k < started; k ++) { pthread_join(tids[k], NULL); }
+  }
+  for(k = 0; k < threads; k ++) { free(hw[k].work); }
+  free(hw);
+  free(tids);
+
+  if(!threads) { freehpa(h); return NULL; }
+  return h;
+} /* createhpa() */
+
+void
+freehpa(HPA *h)
+{
+  if(!h) { return; }
+  if(h->node) { free(h->node); }
+  if(h->cfirst) { free(h->cfirst); }
+  if(h->first) { free(h->first); }
+  if(h->to) { free(h->to); }
+  if(h->weight) { free(h->weight); }
+  if(h->dist) { free(h->dist); }
+  if(h->pnode) { free(h->pnode); }
+  if(h->stamp) { free(h->stamp); }
+  if(h->heapf) { free(h->heapf); }
+  if(h->heapn) { free(h->heapn); }
+  if(h->local) { free(h->local); }
+  free(h);
+} /* freehpa() */
+
+/* give a portal a distance, if it's better than what it has */
+static void
+reach(HPA *h, int *len, int n, int d, int from, int target)
+{
+  if((h->stamp[n] == h->query) && (h->dist[n] <= d)) { return; }
+  h->stamp[n] = h->query;
+  h->dist[n] = d;
+  h->pnode[n] = from;
+  heappush(h->heapf, h->heapn, len,
+  	   d + manhattan(h->grid, h->node[n], target), n);
+} /* reach() */
+
+/* Write the cells of a route found by clusterflood(), from its start
+ * to cell id, into out, which has room for dist + 1 cells.
+ */
+static void
+traceback(HPA *h, int *dist, int *prev, int id, int *out)
+{
+  for(int i = dist[localof(h, id)]; i >= 0; i --) {
+    out[i] = id;
+    id = prev[localof(h, id)];
+  }
+} /* traceback() */
+
+/* A* over portals, with the start's cluster flooded to find the way
+ * out and the target's flooded to find the way in. Links are at least
+ * as long as the Manhattan distance between their ends, so the
+ * heuristic is consistent and a portal is final once popped.
+ */
+int
+hpato(HPA *h, DMAP *dm, CELL *c)
+{
+  int area, src, dst, sk, tk, best, bestnode, len, n, m, d, e;
+  int *sdist, *sprev, *tdist, *tprev, *rdist, *rprev, *queue;
+  int *path, *chain, nchain, pos;
+
+  if(!h || !dm || !c) { return DISTANCE_ERROR; }
+  if(dm->grid != h->grid) { return DISTANCE_ERROR; }
+  if(dm->seen) { return DISTANCE_ERROR; }	/* compact maps */
+
+  src = dm->root_id;
+  dst = c->id;
+
+  if(src == dst) {
+    dm->map[dst] = 0;
+    dm->target_id = dst;
+    dm->frontier[0] = NV;
+    return 0;
+  }
+
+  area = h->csize * h->csize;
+  sdist = h->local;
+  sprev = sdist + area;
+  tdist = sprev + area;
+  tprev = tdist + area;
+  rdist = tprev + area;
+  rprev = rdist + area;
+  queue = rprev + area;
+
+  sk = clusterof(h, src);
+  tk = clusterof(h, dst);
+  clusterflood(h, src, sdist, sprev, queue);
+  clusterflood(h, dst, tdist, tprev, queue);
+
+  h->query ++;
+  h->popped = 0;
+  len = 0;
+  best = HPA_FAR;
+  bestnode = NC;
+
+  if((sk == tk) && (sdist[localof(h, dst)] >= 0)) {
+    best = sdist[localof(h, dst)];
+  }
+  for(n = h->cfirst[sk]; n < h->cfirst[sk+1]; n ++) {
+    d = sdist[localof(h, h->node[n])];
+    if(d >= 0) { reach(h, &len, n, d, NC, dst); }
+  }
+
+  while(len) {
+    if(h->heapf[0] >= best) { break; }
+    n = heappop(h->heapf, h->heapn, &len);
+    h->popped ++;
+    /* stale entry, or n already done */
+    if(h->stamp[n] != h->query) { continue; }
+    d = h->dist[n];
+
+    if(clusterof(h, h->node[n]) == tk) {
+      m = tdist[localof(h, h->node[n])];
+      if((m >= 0) && (d + m < best)) {
+        best = d + m;
+	bestnode = n;
+      }
+    }
+
+    /* mark done without losing the distance */
+    h->stamp[n] = -h->query;
+    for(e = h->first[n]; e < h->first[n+1]; e ++) {
+      m = h->to[e];
+      if((h->weight[e] < 0) || (h->stamp[m] == -h->query)) { continue; }
+      reach(h, &len, m, d + h->weight[e], n, dst);
+    }
+  }
+
+  if(best == HPA_FAR) { return DISTANCE_ERROR; }
+
+  /* fill in the route a cluster at a time */
+  path = dm->nextfrontier;
+  if(bestnode == NC) {
+    traceback(h, sdist, sprev, dst, path);
+  } else {
+    /* portals back to the first, in the frontier array for now */
+    chain = dm->frontier;
+    nchain = 0;
+    for(n = bestnode; n != NC; n = h->pnode[n]) { chain[nchain++] = n; }
+
+    n = chain[nchain - 1];
+    traceback(h, sdist, sprev, h->node[n], path);
+    pos = sdist[localof(h, h->node[n])];
+
+    for(int k = nchain - 2; k >= 0; k --) {
+      m = chain[k];
+      if(clusterof(h, h->node[m]) != clusterof(h, h->node[n])) {
+        path[++pos] = h->node[m];
+      } else {
+        clusterflood(h, h->node[n], rdist, rprev, queue);
+	traceback(h, rdist, rprev, h->node[m], path + pos);
+	pos += rdist[localof(h, h->node[m])];
+      }
+      n = m;
+    }
+
+    /* the target's flood points the way from the portal to it */
+    for(m = h->node[bestnode]; m != dst; ) {
+      m = tprev[localof(h, m)];
+      path[++pos] = m;
+    }
+  }
+
+  for(int k = 0; k <= best; k ++) {
+    dm->map[path[k]] = k;
+    if(dm->parent && k) { dm->parent[path[k]] = path[k-1]; }
+  }
+  dm->target_id = dst;
+  dm->frontier[0] = NV;
+
+  return best;
+} /* hpato() */
+
+/* FNV-1a over every cell's east and south links, so an index is not
+ * loaded for another maze of the same size. Kept to 31 bits to sit
+ * in the int header.
+ */
+static int
+linksum(GRID *g)
+{
+  uint32_t sum = 2166136261u;
+
+  syncgrid(g);
+  for(int id = 0; id < g->max; id ++) {
+    sum ^= ((linkbyid(g, id, EAST) != NC) << 1) |
+    	   (linkbyid(g, id, SOUTH) != NC);
+    sum *= 16777619u;
+  }
+  return (int)(sum & 0x7fffffff);
+} /* linksum() */
+
+/* Layout: magic, then ints rows, cols, csize, nodes, ends, linksum(),
+ * then the arrays node, cfirst, first, to, weight. Native byte order.
+ */
+int
+savehpa(HPA *h, FILE *fp)
+{
+  int head[6];
+
+  if(!h || !fp) { return -1; }
+
+  head[0] = h->grid->rows;
+  head[1] = h->grid->cols;
+  head[2] = h->csize;
+  head[3] = h->nodes;
+  head[4] = h->ends;
+  head[5] = linksum(h->grid);
+
+  if((fwrite(HPA_MAGIC, 4, 1, fp) != 1) ||
+     (fwrite(head, sizeof(int), 6, fp) != 6) ||
+     (fwrite(h->node, sizeof(int), h->nodes, fp) != (size_t)h->nodes) ||
+     (fwrite(h->cfirst, sizeof(int), h->crows * h->ccols + 1, fp) !=
+     				(size_t)(h->crows * h->ccols + 1)) ||
+     (fwrite(h->first, sizeof(int), h->nodes + 1, fp) !=
+     				(size_t)(h->nodes + 1)) ||
+     (fwrite(h->to, sizeof(int), h->ends, fp) != (size_t)h->ends) ||
+     (fwrite(h->weight, sizeof(int), h->ends, fp) != (size_t)h->ends)) {
+    return -1;
+  }
+  return 0;
+} /* savehpa() */
+
+/* Everything hpato() indexes by must be in range: portals are grid
+ * cells in their own cluster, in id order, the start arrays never go
+ * down, and links lead to portals. Returns 0 if the index is sane.
+ */
+static int
+checkhpa(HPA *h)
+{
+  int clusters = h->crows * h->ccols;
+
+  if((h->cfirst[0] != 0) || (h->cfirst[clusters] != h->nodes) ||
+     (h->first[0] != 0) || (h->first[h->nodes] != h->ends)) {
+    return -1;
+  }
+  for(int k = 0; k < clusters; k ++) {
+    if(h->cfirst[k] > h->cfirst[k+1]) { return -1; }
+    for(int n = h->cfirst[k]; n < h->cfirst[k+1]; n ++) {
+      if((h->node[n] < 0) || (h->node[n] >= h->grid->max) ||
+         (clusterof(h, h->node[n]) != k) ||
+	 ((n > h->cfirst[k]) && (h->node[n] <= h->node[n-1]))) {
+	return -1;
+      }
+    }
+  }
+  for(int n = 0; n < h->nodes; n ++) {
+    if(h->first[n] > h->first[n+1]) { return -1; }
+  }
+  for(int e = 0; e < h->ends; e ++) {
+    if((h->to[e] < 0) || (h->to[e] >= h->nodes) || (h->weight[e] < -1)) {
+      return -1;
+    }
+  }
+  return 0;
+} /* checkhpa() */
+
+/* Reads what savehpa() wrote, for the same grid: a file for another
+ * grid, or one that does not hold together, gives NULL.
+ */
+HPA *
+loadhpa(GRID *g, FILE *fp)
+{
+  HPA *h;
+  char magic[4];
+  int head[6], clusters;
+
+  if(!g || !fp) { return NULL; }
+
+  if((fread(magic, 4, 1, fp) != 1) || memcmp(magic, HPA_MAGIC, 4) ||
+     (fread(head, sizeof(int), 6, fp) != 6)) {
+    return NULL;
+  }
+  /* cluster area must fit an int, there are no more portals than cells */
+  if((head[0] != g->rows) || (head[1] != g->cols) || (head[2] < 1) ||
+     (head[2] > 46340) || (head[3] < 0) || (head[3] > g->max) ||
+     (head[4] < 0) || (head[5] != linksum(g))) {
+    return NULL;
+  }
+
+  h = (HPA *)calloc( 1, sizeof(HPA) );
+  if(!h) { return NULL; }
+
+  h->grid = g;
+  h->csize = head[2];
+  h->nodes = head[3];
+  h->ends = head[4];
+  h->crows = (g->rows + h->csize - 1) / h->csize;
+  h->ccols = (g->cols + h->csize - 1) / h->csize;
+  clusters = h->crows * h->ccols;
+
+  h->node = malloc( (h->nodes + 1) * sizeof(int) );
+  h->cfirst = malloc( (clusters + 1) * sizeof(int) );
+  h->first = malloc( (h->nodes + 1) * sizeof(int) );
+  h->to = malloc( (h->ends + 1) * sizeof(int) );
+  h->weight = malloc( (h->ends + 1) * sizeof(int) );
+  if(!h->node || !h->cfirst || !h->first || !h->to || !h->weight ||
+     allocwork(h)) {
+    freehpa(h);
+    return NULL;
+  }
+
+  if((fread(h->node, sizeof(int), h->nodes, fp) != (size_t)h->nodes) ||
+     (fread(h->cfirst, sizeof(int), clusters + 1, fp) !=
+     				(size_t)(clusters + 1)) ||
+     (fread(h->first, sizeof(int), h->nodes + 1, fp) !=
+     				(size_t)(h->nodes + 1)) ||
+     (fread(h->to, sizeof(int), h->ends, fp) != (size_t)h->ends) ||
+     (fread(h->weight, sizeof(int), h->ends, fp) != (size_t)h->ends) ||
+     checkhpa(h)) {
+    freehpa(h);
+    return NULL;
+  }
+
+  return h;
+} /* loadhpa() */
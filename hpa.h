@@ -0,0 +1,63 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+/* hierarchical (HPA*) index for solving very large mazes, needs -pthread */
+
+#ifndef _HPA_H
+#define _HPA_H
+
+#include <stdio.h>
+
+#include "grid.h"
+#include "distance.h"
+
+#define HPA_CLUSTER	32	/* default cluster edge, in cells */
+
+/* The grid is cut into square clusters. Every cell with a connection
+ * leaving its cluster is a portal. Portals link to their neighbors
+ * across cluster borders (one step) and to every other portal of
+ * their own cluster (steps by the shortest route inside it). Any
+ * path is a run of inside routes and border crossings, so searching
+ * portals gives exact distances, and the route is then filled in
+ * a cluster at a time. No part of this structure is intended to be
+ * changed by users.
+ */
+typedef struct {
+  GRID *grid;
+  int csize;		/* cluster edge, in cells */
+  int crows, ccols;	/* clusters down and across */
+  int nodes;		/* portals, grouped by cluster, by id within */
+  int ends;		/* portal links, counted from both ends */
+  int *node;		/* cell id of each portal */
+  int *cfirst;		/* portals of cluster k are cfirst[k] to cfirst[k+1] - 1 */
+  int *first;		/* links of portal n are first[n] to first[n+1] - 1 */
+  int *to;		/* portal each link leads to */
+  int *weight;		/* its steps, -1 for portals not connected inside */
+  /* per query work space */
+  int *dist;		/* steps from the start, valid if stamp matches */
+  int *pnode;		/* portal each was reached from, NC for the first */
+  int *stamp;		/* query each portal was last reached in */
+  int *heapf;		/* priority queue keys */
+  int *heapn;		/* and portals */
+  int *local;		/* three cluster sized dist and prev pairs, a queue */
+  int query;		/* count of queries */
+  int popped;		/* portals taken off the queue by the last query */
+} HPA;
+
+/* build with up to threads threads, 0 for one per cpu; cluster size
+ * 0 for HPA_CLUSTER. The grid should not change after.
+ */
+HPA *createhpa(GRID *, int /* cluster size */, int /* threads */);
+void freehpa(HPA *);
+
+/* Distance from the root of a new or reset distance map to a cell.
+ * Like astarto(), findpath() then gives the cells, but only cells on
+ * that path are in the map.
+ */
+int hpato(HPA *, DMAP *, CELL *);
+
+/* write an index out, and read one back for the same grid; loading
+ * gives NULL for a damaged file or one saved from another maze
+ */
+int savehpa(HPA *, FILE *);
+HPA *loadhpa(GRID *, FILE *);
+
+#endif
@@ -1,9 +1,12 @@
 /* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
 /* ways to put a maze in a grid */
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #include "mazes.h"
+#include "fastrand.h"
 
 /* binary tree maze, iterategrid() call back */ 
 int
@@ -148,6 +151,166 @@ hollow(GRID *g, CELL *c, void *unused)
 } /* hollow() */
 
 
+/* fastrand() seeded from random(), so srandom() still repeats a maze */
+static uint64_t
+fastseed(void)
+{
+  return ((uint64_t)random() << 32) ^ (uint64_t)random() ^ 0x9E3779B97F4A7C15ULL;
+} /* fastseed() */
+
+/* neighbor of a cell of an area, by index within it, or NC */
+static int
+areastep(MAZEAREA *a, int li, int go)
+{
+  switch(go) {
+    case NORTH: return (li >= a->w) ? li - a->w : NC;
+    case SOUTH: return (li < (a->h - 1) * a->w) ? li + a->w : NC;
+    case WEST:  return (li % a->w) ? li - 1 : NC;
+    case EAST:  return (li % a->w < a->w - 1) ? li + 1 : NC;
+  }
+  return NC;
+} /* areastep() */
+
+/* grid id of a cell of an area */
+static int
+areaid(MAZEAREA *a, int li)
+{
+  return (a->r0 + li / a->w) * a->g->cols + a->c0 + li % a->w;
+} /* areaid() */
+
+/* open the wall between two cells of an area, marking the second seen */
+static void
+areacarve(MAZEAREA *a, int li, int go, int nb)
+{
+  a->seen[nb] = 1;
+  connectbyid(a->g, areaid(a, li), go, areaid(a, nb), SYMMETRICAL);
+} /* areacarve() */
+
+/* An area can't be walked without somewhere to start: a random cell
+ * is marked seen if none is. Puts a seen cell in from, returns the
+ * number of cells unseen.
+ */
+static int
+areastart(MAZEAREA *a, int *from)
+{
+  int n = a->h * a->w, left = 0;
+
+  *from = NC;
+  for(int li = 0; li < n; li ++) {
+    if(!a->seen[li]) {
+      left ++;
+    } else if(*from == NC) {
+      *from = li;
+    }
+  }
+  if(*from == NC) {
+    *from = fastbelow(&a->rng, n);
+    a->seen[*from] = 1;
+    left --;
+  }
+  return left;
+} /* areastart() */
+
+/* The Aldous-Broder random walk over an area, from a seen cell,
+ * stopping once only tovisit cells are left unseen.
+ */
+int
+aldbroarea(MAZEAREA *a, int tovisit)
+{
+  int left, cur, nb, go;
+
+  left = areastart(a, &cur);
+
+  while(left > tovisit) {
+    go = fastbelow(&a->rng, FOURDIRECTIONS);
+    nb = areastep(a, cur, go);
+    if(nb == NC) { continue; }
+    if(!a->seen[nb]) {
+      areacarve(a, cur, go, nb);
+      left --;
+    }
+    cur = nb;
+  } /* while cells to visit */
+
+  return 0;
+} /* aldbroarea() */
+
+/* Wilson's loop-erased random walks over an area: from each unseen
+ * cell, walk randomly until reaching a seen cell, remembering only
+ * the last way out of each cell, so loops erase themselves. Then
+ * follow those exits from the start, carving the path into the maze.
+ */
+int
+wilsonarea(MAZEAREA *a)
+{
+  int n = a->h * a->w;
+  int start, cur, nb, go;
+
+  areastart(a, &cur);
+  for(start = 0; start < n; start ++) {
+    if(a->seen[start]) { continue; }
+
+    for(cur = start; !a->seen[cur]; cur = nb) {
+      do {
+	go = fastbelow(&a->rng, FOURDIRECTIONS);
+	nb = areastep(a, cur, go);
+      } while(nb == NC);
+      a->exits[cur] = go;
+    } /* random walk */
+
+    for(cur = start; !a->seen[cur]; cur = nb) {
+      go = a->exits[cur];
+      nb = areastep(a, cur, go);
+      a->seen[cur] = 1;
+      connectbyid(a->g, areaid(a, cur), go, areaid(a, nb), SYMMETRICAL);
+    } /* carve loop-erased path */
+  }
+
+  return 0;
+} /* wilsonarea() */
+
+/* A whole grid as an area, seen loaded from ctype, rng from random().
+ * exits only if asked for.
+ */
+static int
+gridarea(GRID *g, MAZEAREA *a, int exits)
+{
+  a->g = g;
+  a->r0 = a->c0 = 0;
+  a->h = g->rows;
+  a->w = g->cols;
+  a->seen = (unsigned char *)malloc((size_t)g->max);
+  a->exits = exits ? (unsigned char *)malloc((size_t)g->max) : NULL;
+  a->stack = NULL;
+  a->cap = 0;
+  a->rng = fastseed();
+  if(!a->seen || (exits && !a->exits)) {
+    if(a->seen) { free(a->seen); }
+    if(a->exits) { free(a->exits); }
+    return -1;
+  }
+
+  /* the walks work on ids, skipping CELL structs */
+  syncgrid(g);
+  for(int id = 0; id < g->max; id ++) {
+    a->seen[id] = (ctypebyid(g, id) != UNVISITED);
+  }
+  return 0;
+} /* gridarea() */
+
+/* done with a whole grid area: seen cells become VISITED */
+static int
+putarea(MAZEAREA *a, int rc)
+{
+  for(int id = 0; id < a->g->max; id ++) {
+    if(a->seen[id]) { setctypebyid(a->g, id, VISITED); }
+  }
+  free(a->seen);
+  if(a->exits) { free(a->exits); }
+  if(a->stack) { free(a->stack); }
+  return rc;
+} /* putarea() */
+
 /* Named for David Aldous and Andrei Broder, this method cannot
  * use the grid iterator because it needs to visit cells randomly,
  * and it needs to be able to revisit cells.
@@ -155,47 +318,481 @@ hollow(GRID *g, CELL *c, void *unused)
 int
 aldbro(GRID *g)
 {
-  CELL *cc, *nc;
-  int edges;
-  int tovisit;
-  int go;
+  MAZEAREA a;
+
+  if(!g) { return -1; }
+  if(gridarea(g, &a, 0)) { return -1; }
+
+  return putarea(&a, aldbroarea(&a, 0));
+} /* aldbro() */
+
+/* Named for David Wilson. Same uniform spanning tree results as
+ * aldbro(), but doesn't spend ages hunting for the last few
+ * unvisited cells. Starts with one random cell in the maze.
+ * Like aldbro(), wants a grid created with UNVISITED gtype.
+ */
+int
+wilson(GRID *g)
+{
+  MAZEAREA a;
+
+  if(!g) { return -1; }
+  if(gridarea(g, &a, 1)) { return -1; }
+
+  return putarea(&a, wilsonarea(&a));
+} /* wilson() */
+
+/* Aldous-Broder is quick early on, when most cells it finds are new,
+ * and Wilson's is quick late, when the maze is big enough to hit.
+ * This runs aldbro() until percent of the cells are visited, then
+ * finishes with Wilson's. Results are still uniform spanning trees.
+ */
+int
+aldbrowilson(GRID *g, int percent)
+{
+  MAZEAREA a;
+  int rc;
 
   if(!g) { return -1; }
+  if(percent < 0) { percent = 0; }
+  if(percent > 100) { percent = 100; }
+  if(gridarea(g, &a, 1)) { return -1; }
+
+  rc = aldbroarea(&a, g->max - (int)((long)g->max * percent / 100));
+  if(rc) { return putarea(&a, rc); }
 
-  cc = visitrandom(g);
-  if(!cc) { return -1; }
-  cc->ctype = VISITED;
-  tovisit = g->max - 1;
+  return putarea(&a, wilsonarea(&a));
+} /* aldbrowilson() */
 
-  go = NEEDDIR;
 
-  while(tovisit) {
+/* find the set a label belongs to, halving the path as it goes, for
+ * eller() and kruskal()
+ */
+static int
+findset(int *parent, int l)
+{
+  while(parent[l] != l) {
+    parent[l] = parent[parent[l]];
+    l = parent[l];
+  }
+  return l;
+} /* findset() */
+
+/* Named for Joseph Kruskal. Every east and south wall goes in a list,
+ * the list is shuffled, then each wall in turn is opened if the cells
+ * on either side aren't joined yet. Sets of joined cells are a union
+ * find forest (path halving, union by rank), so the whole thing takes
+ * a shuffle and near constant time per wall, however the dice fall.
+ * Doesn't use ctype.
+ */
+int
+kruskal(GRID *g)
+{
+  int *walls, *parent;
+  unsigned char *rank;
+  int nw, w, id, n, go, a, b, joins;
+  uint64_t state;
 
-    edges = edgestatusbycell(g,cc);
-    
-    while( go > FOURDIRECTIONS ) {
-      go = FIRSTDIR + (random() % FOURDIRECTIONS);
-      if((go == NORTH) && (edges & NORTH_EDGE)) { go = NEEDDIR; }
-      if((go == SOUTH) && (edges & SOUTH_EDGE)) { go = NEEDDIR; }
-      if((go == WEST ) && (edges &  WEST_EDGE)) { go = NEEDDIR; }
-      if((go == EAST ) && (edges &  EAST_EDGE)) { go = NEEDDIR; }
-    } /* pick a viable direction */
+  if(!g) { return -1; }
 
-    nc = visitdir(g, cc, go, ANY);
-    if(!nc) { return -1; }
+  walls = (int *)malloc((size_t)g->max * 2 * sizeof(int));
+  parent = (int *)malloc((size_t)g->max * sizeof(int));
+  rank = (unsigned char *)calloc((size_t)g->max, 1);
+  if(!walls || !parent || !rank) {
+    free(walls);
+    free(parent);
+    free(rank);
+    return -1;
+  }
 
-    if(nc->ctype == UNVISITED) {
-      nc->ctype = VISITED;
-      tovisit --;
-      connectbycell(cc, go, nc, SYMMETRICAL);
+  /* a wall is a cell id times two, plus one for its south wall */
+  nw = 0;
+  for(id = 0; id < g->max; id ++) {
+    parent[id] = id;
+    if(id % g->cols < g->cols - 1) { walls[nw++] = 2 * id; }
+    if(id / g->cols < g->rows - 1) { walls[nw++] = 2 * id + 1; }
+  }
+
+  state = fastseed();
+  for(w = nw - 1; w > 0; w --) {
+    n = fastbelow(&state, (uint32_t)w + 1);
+    id = walls[w];
+    walls[w] = walls[n];
+    walls[n] = id;
+  }
+
+  syncgrid(g);
+  joins = 0;
+  for(w = 0; (w < nw) && (joins < g->max - 1); w ++) {
+    id = walls[w] / 2;
+    if(walls[w] & 1) {
+      go = SOUTH;
+      n = id + g->cols;
+    } else {
+      go = EAST;
+      n = id + 1;
     }
 
-    cc = nc;
-    go = NEEDDIR;
+    a = findset(parent, id);
+    b = findset(parent, n);
+    if(a == b) { continue; }
 
-  } /* while cells to visit */
+    if(rank[a] < rank[b]) { int t = a; a = b; b = t; }
+    parent[b] = a;
+    if(rank[a] == rank[b]) { rank[a] ++; }
+
+    connectbyid(g, id, go, n, SYMMETRICAL);
+    joins ++;
+  }
 
+  free(walls);
+  free(parent);
+  free(rank);
   return 0;
-} /* aldbro() */
+} /* kruskal() */
+
+/* The growing tree family. Cells in the maze with unvisited
+ * neighbors are active. Each step picks an active cell, by weights
+ * for the newest, a random one, or the oldest, and carves to one of
+ * its unvisited neighbors, which becomes active too; a cell with none
+ * left stops being active. All newest is the recursive backtracker,
+ * all random is much like Prim's, all oldest makes long straight runs
+ * out from the start.
+ *
+ * Active cells are an array in the order added, from head to n. The
+ * oldest leaves by moving head, the newest by shrinking n, any other
+ * by having the newest moved into its place, so every step is O(1)
+ * and the whole maze O(cells). (Those moves leave age order a little
+ * shuffled when mixing in random picks.) Cell state is ctype, as in
+ * aldbro(); wants a grid created with UNVISITED gtype.
+ */
+int
+growingtree(GRID *g, int newest, int any, int oldest)
+{
+  int *active;
+  int head, n, i, id, nc, go, left;
+  int ways[FOURDIRECTIONS];
+  uint32_t pick, sum;
+  uint64_t state;
+
+  if(!g) { return -1; }
+  if((newest < 0) || (any < 0) || (oldest < 0)) { return -1; }
+  sum = (uint32_t)newest + any + oldest;
+  if(!sum) { return -1; }
+
+  active = (int *)malloc((size_t)g->max * sizeof(int));
+  if(!active) { return -1; }
+
+  syncgrid(g);
+  state = fastseed();
+
+  id = fastbelow(&state, g->max);
+  setctypebyid(g, id, VISITED);
+  head = 0;
+  n = 0;
+  active[n++] = id;
+
+  while(n > head) {
+    pick = fastbelow(&state, sum);
+    if(pick < (uint32_t)newest) {
+      i = n - 1;
+    } else if(pick < (uint32_t)newest + any) {
+      i = head + fastbelow(&state, n - head);
+    } else {
+      i = head;
+    }
+    id = active[i];
+
+    left = 0;
+    for(go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+      nc = nextid(g, id, go);
+      if((nc != NC) && (ctypebyid(g, nc) == UNVISITED)) { ways[left++] = go; }
+    }
+
+    if(!left) {
+      if(i == head) {
+        head ++;
+      } else {
+        active[i] = active[--n];
+      }
+      continue;
+    }
+
+    go = ways[fastbelow(&state, left)];
+    nc = nextid(g, id, go);
+    setctypebyid(g, nc, VISITED);
+    connectbyid(g, id, go, nc, SYMMETRICAL);
+    active[n++] = nc;
+  } /* while cells are active */
+
+  free(active);
+  return 0;
+} /* growingtree() */
+
+/* The order backtracker() tries directions from a cell: one of the
+ * 24 orderings of the four, chosen by hashing the cell id with the
+ * maze's seed, so it can be worked out again at any time instead of
+ * stored. Gives the k-th direction (0 to 3) of that order.
+ */
+static int
+triedorder(uint64_t seed, int id, int k)
+{
+  uint64_t h = ((uint64_t)id + seed) * 0x9E3779B97F4A7C15ULL;
+  int code, left[FOURDIRECTIONS] = { NORTH, WEST, EAST, SOUTH };
+  int base = 24, n = FOURDIRECTIONS, pick = 0;
+
+  h ^= h >> 29;
+  code = (int)(((h & 0xffffffff) * 24) >> 32);
+
+  /* factorial number system: peel off one choice per place */
+  for(int place = 0; place <= k; place ++) {
+    base /= n;
+    pick = code / base;
+    code %= base;
+    n --;
+    if(place < k) {
+      for(int m = pick; m < n; m ++) { left[m] = left[m + 1]; }
+    }
+  }
+  return left[pick];
+} /* triedorder() */
+
+/* The recursive backtracker, without recursion, over an area with
+ * nothing seen yet. Walks from a random cell to random unseen
+ * neighbors, backing up to the last cell with any left when stuck.
+ * The stack holds the current path only, each entry a cell index
+ * shifted up two bits, plus how many directions it has tried (0 to
+ * 3; a cell that has tried its last is popped as it moves on). The
+ * order it tries them in is triedorder()'s, not kept. The stack
+ * doubles when full; areas are under 2^30 cells.
+ */
+int
+backtrackarea(MAZEAREA *a)
+{
+  uint32_t *bigger;
+  int sp, li, nb, go, tried;
+  uint64_t seed;
+
+  if(a->h * a->w > (1 << 30)) { return -1; }
+  if(!a->stack) {
+    a->cap = 1024;
+    a->stack = (uint32_t *)malloc(a->cap * sizeof(uint32_t));
+    if(!a->stack) { return -1; }
+  }
+
+  seed = fastrand(&a->rng);
+  li = fastbelow(&a->rng, a->h * a->w);
+  a->seen[li] = 1;
+  sp = 0;
+  a->stack[sp++] = (uint32_t)li << 2;
+
+  while(sp) {
+    li = a->stack[sp - 1] >> 2;
+    tried = a->stack[sp - 1] & 3;
+
+    nb = NC;
+    go = NC;
+    while((nb == NC) && (tried < FOURDIRECTIONS)) {
+      go = triedorder(seed, li, tried ++);
+      nb = areastep(a, li, go);
+      if((nb != NC) && a->seen[nb]) { nb = NC; }
+    }
+
+    /* a cell with nothing left to try is done with */
+    if(tried == FOURDIRECTIONS) {
+      sp --;
+    } else {
+      a->stack[sp - 1] = ((uint32_t)li << 2) | tried;
+    }
+    if(nb == NC) { continue; }
+
+    areacarve(a, li, go, nb);
+
+    if(sp == a->cap) {
+      bigger = (uint32_t *)realloc(a->stack, 2 * a->cap * sizeof(uint32_t));
+      if(!bigger) { return -1; }
+      a->stack = bigger;
+      a->cap *= 2;
+    }
+    a->stack[sp++] = (uint32_t)nb << 2;
+  } /* while backing up */
+
+  return 0;
+} /* backtrackarea() */
+
+/* backtrackarea() over a whole grid. Cell state is ctype, as in
+ * aldbro(); wants a grid created with UNVISITED gtype.
+ */
+int
+backtracker(GRID *g)
+{
+  MAZEAREA a;
 
+  if(!g) { return -1; }
+  if(g->max > (1 << 30)) { return -1; }
+  if(gridarea(g, &a, 0)) { return -1; }
+
+  return putarea(&a, backtrackarea(&a));
+} /* backtracker() */
+
+/* Eller's algorithm, named for Marlin Eller. Each cell of the current
+ * row carries a set label; cells in the same set are already joined
+ * by some path above. Neighbors in different sets are randomly joined
+ * east, then every set randomly drops at least one path south, and
+ * cells without a path down start new sets in the next row. The last
+ * row joins everything left. Memory is a few arrays of cols entries,
+ * whatever the number of rows.
+ */
+int
+eller(int rows, int cols, int (*emit)(MAZEROW *, void *), void *param)
+{
+  MAZEROW mr;
+  int *sets, *parent, *count, *used;
+  int j, l, rc;
+  int down, fresh;
+
+  if(cols < 1) { return -1; }
+  if(!emit) { return -1; }
+
+  sets = (int *)malloc((size_t)cols * sizeof(int));
+  parent = (int *)malloc((size_t)cols * sizeof(int));
+  count = (int *)malloc((size_t)cols * sizeof(int));
+  used = (int *)malloc((size_t)cols * sizeof(int));
+  mr.east = (unsigned char *)malloc((size_t)cols);
+  mr.south = (unsigned char *)malloc((size_t)cols);
+  if(!sets || !parent || !count || !used || !mr.east || !mr.south) {
+    rc = -1;
+    goto done;
+  }
+
+  mr.cols = cols;
+  for(j = 0; j < cols; j ++) {
+    sets[j] = j;
+  }
+
+  rc = 0;
+  for(mr.row = 0; (rows <= 0) || (mr.row < rows); mr.row ++) {
+    mr.last = (mr.row == rows - 1);
+
+    for(j = 0; j < cols; j ++) {
+      parent[j] = j;
+      count[j] = 0;
+      mr.south[j] = 0;
+    }
+
+    /* join east */
+    for(j = 0; j < cols - 1; j ++) {
+      int a = findset(parent, sets[j]);
+      int b = findset(parent, sets[j+1]);
+      mr.east[j] = 0;
+      if((a != b) && (mr.last || (random()%2 == 1))) {
+        mr.east[j] = 1;
+	parent[b] = a;
+      }
+    }
+    mr.east[cols - 1] = 0;
+
+    /* drop south, at least once per set */
+    if(!mr.last) {
+      for(j = 0; j < cols; j ++) {
+        sets[j] = findset(parent, sets[j]);
+	count[sets[j]] ++;
+	used[j] = 0;
+      }
+      /* used[l] is true once set l has a path down */
+      for(j = 0; j < cols; j ++) {
+        l = sets[j];
+	count[l] --;
+	down = (random()%2 == 1);
+	if(!used[l] && (count[l] == 0)) { down = 1; }
+	if(down) {
+	  mr.south[j] = 1;
+	  used[l] = 1;
+	}
+      }
+    }
+
+    rc = emit(&mr, param);
+    if(rc || mr.last) { break; }
+
+    /* cells with no path down start new sets, using unused labels */
+    for(l = 0; l < cols; l ++) {
+      used[l] = 0;
+    }
+    for(j = 0; j < cols; j ++) {
+      if(mr.south[j]) { used[sets[j]] = 1; }
+    }
+    fresh = 0;
+    for(j = 0; j < cols; j ++) {
+      if(!mr.south[j]) {
+        while(used[fresh]) { fresh ++; }
+	sets[j] = fresh;
+	used[fresh] = 1;
+      }
+    }
+  } /* for each row */
+
+done:
+  free(sets);
+  free(parent);
+  free(count);
+  free(used);
+  free(mr.east);
+  free(mr.south);
+  return rc;
+} /* eller() */
+
+/* eller() call back, ASCII art to a FILE* (or stdout if NULL).
+ * Same picture as ascii_grid() without names.
+ */
+int
+ellerascii(MAZEROW *mr, void *fp)
+{
+  FILE *out = fp ? (FILE *)fp : stdout;
+  int j;
+
+  if(!mr) { return -1; }
+
+  if(mr->row == 0) {
+    for(j = 0; j < mr->cols; j ++) { fputs("+---", out); }
+    fputs("+\n", out);
+  }
+
+  putc('|', out);
+  for(j = 0; j < mr->cols; j ++) {
+    fputs(mr->east[j] ? "    " : "   |", out);
+  }
+  putc('\n', out);
+
+  putc('+', out);
+  for(j = 0; j < mr->cols; j ++) {
+    fputs(mr->south[j] ? "   +" : "---+", out);
+  }
+  putc('\n', out);
+
+  return ferror(out) ? -1 : 0;
+} /* ellerascii() */
 
+/* eller() call back, carves each row into a GRID. Stops the stream
+ * if it runs past the bottom of the grid.
+ */
+int
+ellergrid(MAZEROW *mr, void *grid)
+{
+  GRID *g = (GRID *)grid;
+  int id;
+
+  if(!mr || !g) { return -1; }
+  if((mr->row >= g->rows) || (mr->cols != g->cols)) { return -1; }
+
+  id = mr->row * g->cols;
+  for(int j = 0; j < mr->cols; j ++, id ++) {
+    if(mr->east[j]) {
+      connectbyid(g, id, EAST, id + 1, SYMMETRICAL);
+    }
+    if(mr->south[j] && (mr->row < g->rows - 1)) {
+      connectbyid(g, id, SOUTH, id + g->cols, SYMMETRICAL);
+    }
+  }
+  return 0;
+} /* ellergrid() */
@@ -18,6 +18,34 @@ typedef struct {
   int runstart_c;
 } sw_tree_status;
 
+/* one row of a maze streamed by eller(); east and south are
+ * booleans per column, true where the cell opens that way.
+ */
+typedef struct {
+  int row;
+  int cols;
+  int last;		/* true on the final row */
+  unsigned char *east;
+  unsigned char *south;
+} MAZEROW;
+
+/* A rectangle of a grid for the walk cores below, which only link
+ * cells inside it. seen marks cells in the maze, by index within the
+ * rectangle (row * w + col), and rng is a fastrand() state (never 0);
+ * nothing is shared, so walks in areas that don't overlap can run at
+ * once on one grid. The grid must be synced, see syncgrid().
+ */
+typedef struct {
+  GRID *g;
+  int r0, c0;		/* top left cell */
+  int h, w;		/* rows and columns */
+  unsigned char *seen;	/* h * w bytes */
+  unsigned char *exits;	/* h * w bytes, for wilsonarea() */
+  uint32_t *stack;	/* backtrackarea() path, malloc'd if NULL */
+  int cap;		/* room in stack, in entries, grown as needed */
+  uint64_t rng;
+} MAZEAREA;
+
 /* iterategrid() call backs; these can generate a "maze" by visiting
  * every cell once in any order.
  */
@@ -30,5 +58,44 @@ int hollow(GRID *, CELL *, void *);
  * visit ordering
  */
 int aldbro(GRID *);
+int wilson(GRID *);
+
+/* aldbro() until percent of cells are visited, then Wilson's */
+int aldbrowilson(GRID *, int /*percent*/);
+#define ALDBROWILSON_PERCENT	30
+
+/* randomized Kruskal's, shuffled walls and a union find */
+int kruskal(GRID *);
+
+/* growing tree: which active cell grows next, picked by weights for
+ * the newest, a random one, and the oldest. (1,0,0) is a backtracker,
+ * (0,1,0) Prim's style, (0,0,1) oldest first; mixes are fine.
+ */
+int growingtree(GRID *, int /*newest*/, int /*random*/, int /*oldest*/);
+
+/* recursive backtracker on an explicit stack of the current path */
+int backtracker(GRID *);
+
+/* The walks of aldbro(), wilson() and backtracker() over one area:
+ * Aldous-Broder until tovisit cells are unseen, then Wilson's, each
+ * starting from a random cell if none is seen; the backtracker wants
+ * none seen. Return 0, or -1 if out of memory.
+ */
+int aldbroarea(MAZEAREA *, int /*tovisit*/);
+int wilsonarea(MAZEAREA *);
+int backtrackarea(MAZEAREA *);
+
+/* streaming generator; makes a maze one row at a time without a GRID,
+ * handing each row to a call back. rows <= 0 makes rows until the
+ * call back returns non-zero. Returns 0, or the non-zero value from
+ * the call back that stopped it.
+ */
+int eller(int /*rows*/, int /*cols*/, int(*)(MAZEROW *, void *), void *);
+
+/* eller() call backs: write ASCII art like ascii_grid() to a FILE*
+ * (NULL for stdout), or carve rows into a GRID of the same size.
+ */
+int ellerascii(MAZEROW *, void *);
+int ellergrid(MAZEROW *, void *);
 
 #endif
@@ -0,0 +1,838 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+/* multithreaded distance and maze tools, link with -pthread */
+
+/* pthread_barrier_t and sysconf() are POSIX 2001, not plain C99 */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "grid.h"
+#include "distance.h"
+#include "mazes.h"
+#include "parallel.h"
+#include "fastrand.h"
+
+/* shared state of one paralleldistanceto() run */
+typedef struct {
+  DMAP *dm;
+  int far;		/* distance of cells in dm->frontier */
+  int nf;		/* cells in dm->frontier */
+  int taken;		/* frontier cells handed out so far */
+  int next;		/* cells added to dm->nextfrontier so far */
+  int done;		/* set when there are no more levels */
+  pthread_mutex_t ready;	/* held until the barriers are set up */
+  pthread_barrier_t start;
+  pthread_barrier_t end;
+} PFLOOD;
+
+/* one worker's share of a run */
+typedef struct {
+  PFLOOD *pf;
+  int n;
+  int local[PARALLEL_LOCAL];
+} PWORKER;
+
+int
+defaultthreads(void)
+{
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if(n < 1) { return 1; }
+  if(n > PARALLEL_MAXTHREADS) { return PARALLEL_MAXTHREADS; }
+  return (int)n;
+} /* defaultthreads() */
+
+/* move a worker's local cells to the shared next frontier */
+static void
+flushlocal(PWORKER *pw)
+{
+  int at;
+
+  if(!pw->n) { return; }
+  at = __atomic_fetch_add(&pw->pf->next, pw->n, __ATOMIC_RELAXED);
+  memcpy(pw->pf->dm->nextfrontier + at, pw->local, pw->n * sizeof(int));
+  pw->n = 0;
+} /* flushlocal() */
+
+/* Expand chunks of the frontier until none are left. A cell belongs
+ * to whichever thread moves its map entry from NOT_VISITED first.
+ */
+static void
+floodlevel(PWORKER *pw)
+{
+  PFLOOD *pf = pw->pf;
+  DMAP *dm = pf->dm;
+  int *map = dm->map;
+  int at, end, fid, vid, expect;
+
+  while((at = __atomic_fetch_add(&pf->taken, PARALLEL_CHUNK,
+  				 __ATOMIC_RELAXED)) < pf->nf) {
+    end = at + PARALLEL_CHUNK;
+    if(end > pf->nf) { end = pf->nf; }
+
+    for( ; at < end; at ++) {
+      fid = dm->frontier[at];
+      for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+	vid = linkbyid(dm->grid, fid, go);
+	if((vid < 0) || (vid >= dm->msize)) { continue; }
+	if(__atomic_load_n(&map[vid], __ATOMIC_RELAXED) != NOT_VISITED) {
+	  continue;
+	}
+	expect = NOT_VISITED;
+	if(!__atomic_compare_exchange_n(&map[vid], &expect, pf->far + 1, 0,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	  continue;
+	}
+	if(dm->parent) { dm->parent[vid] = fid; }
+	pw->local[pw->n++] = vid;
+	if(pw->n == PARALLEL_LOCAL) { flushlocal(pw); }
+      }
+    }
+  }
+  flushlocal(pw);
+} /* floodlevel() */
+
+/* helper threads do levels until told there are no more */
+static void *
+floodworker(void *arg)
+{
+  PWORKER *pw = (PWORKER *)arg;
+
+  pthread_mutex_lock(&pw->pf->ready);
+  pthread_mutex_unlock(&pw->pf->ready);
+
+  while(1) {
+    pthread_barrier_wait(&pw->pf->start);
+    if(pw->pf->done) { break; }
+    floodlevel(pw);
+    pthread_barrier_wait(&pw->pf->end);
+  }
+  return NULL;
+} /* floodworker() */
+
+/* Level synchronous flood. Each level's frontier is split between
+ * threads in chunks; new cells are claimed with a compare and swap
+ * on the map and gathered in a small local list per thread, which is
+ * appended to the next frontier when full and at the end of the
+ * level. The calling thread works too, and between levels (while
+ * the others wait at a barrier) swaps the frontiers. Levels smaller
+ * than PARALLEL_SERIAL cells it does alone, so long thin floods in
+ * twisty mazes don't pay for two barriers a step.
+ */
+int
+paralleldistanceto(DMAP *dm, CELL *c, int lazy, int threads)
+{
+  PFLOOD pf;
+  PWORKER *pw;
+  pthread_t *tids;
+  int want, found, started, *swap;
+
+  if(!dm) { return DISTANCE_ERROR; }
+  if(!c) { return DISTANCE_ERROR; }
+  if(dm->seen) { return DISTANCE_ERROR; }	/* compact maps */
+
+  want = c->id;
+
+  /* the trivial case */
+  if(lazy && (dm->root_id == want)) {
+    dm->map[want] = 0;
+    dm->target_id = want;
+    return 0;
+  }
+
+  if(threads < 1) { threads = defaultthreads(); }
+  if(threads > PARALLEL_MAXTHREADS) { threads = PARALLEL_MAXTHREADS; }
+
+  /* the flood reads connections by id, not through CELLs */
+  syncgrid(dm->grid);
+
+  pw = (PWORKER *)malloc( threads * sizeof(PWORKER) );
+  tids = (pthread_t *)malloc( threads * sizeof(pthread_t) );
+  if(!pw || !tids) {
+    if(pw) { free(pw); }
+    if(tids) { free(tids); }
+    return DISTANCE_ERROR;
+  }
+
+  pf.dm = dm;
+  pf.far = 0;
+  pf.done = 0;
+  for(pf.nf = 0; dm->frontier[pf.nf] != NV; pf.nf ++) {
+    dm->map[dm->frontier[pf.nf]] = 0;
+  }
+
+  for(int t = 0; t < threads; t ++) {
+    pw[t].pf = &pf;
+    pw[t].n = 0;
+  }
+
+  /* if not all threads can be had, make do with those that can */
+  pthread_mutex_init(&pf.ready, NULL);
+  pthread_mutex_lock(&pf.ready);
+  for(started = 1; started < threads; started ++) {
+    if(pthread_create(&tids[started], NULL, floodworker, &pw[started])) {
+      break;
+    }
+  }
+  threads = started;
+  pthread_barrier_init(&pf.start, NULL, threads);
+  pthread_barrier_init(&pf.end, NULL, threads);
+  pthread_mutex_unlock(&pf.ready);
+
+  found = 0;
+  while(1) {
+    /* cells at distance pf.far are all in */
+    if(pf.nf && !lazy && (pf.far > dm->farthest)) {
+      dm->farthest = pf.far;
+      dm->farthest_id = dm->frontier[0];
+    }
+    if(!found && (dm->map[want] >= 0)) {
+      dm->target_id = want;
+      found = 1;
+    }
+    if(!pf.nf || (lazy && found)) { pf.done = 1; }
+
+    pf.taken = 0;
+    pf.next = 0;
+    if(!pf.done && (pf.nf < PARALLEL_SERIAL)) {
+      /* not worth waking anyone for */
+      floodlevel(&pw[0]);
+    } else {
+      pthread_barrier_wait(&pf.start);
+      if(pf.done) { break; }
+      floodlevel(&pw[0]);
+      pthread_barrier_wait(&pf.end);
+    }
+
+    pf.nf = pf.next;
+    dm->nextfrontier[pf.nf] = NV;
+    swap = dm->frontier;
+    dm->frontier = dm->nextfrontier;
+    dm->nextfrontier = swap;
+    pf.far ++;
+  }
+
+  for(int t = 1; t < threads; t ++) { pthread_join(tids[t], NULL); }
+  pthread_barrier_destroy(&pf.start);
+  pthread_barrier_destroy(&pf.end);
+  pthread_mutex_destroy(&pf.ready);
+  free(pw);
+  free(tids);
+
+  /* nothing left to continue from */
+  dm->frontier[0] = NV;
+
+  if(!found) {
+    return(DISTANCE_ERROR);
+  }
+  return lazy ? dm->map[want] : 0;
+} /* paralleldistanceto() */
+
+/* one query, remembered by source for sorting */
+typedef struct {
+  int source;
+  int query;
+} PQUERY;
+
+/* shared state of one batchdistances() run */
+typedef struct {
+  int *targets;
+  int *results;
+  PQUERY *order;	/* queries sorted by source */
+  int *groups;		/* where each source's queries start in order */
+  int ngroups;
+  int taken;		/* groups handed out so far */
+  int found;		/* reachable targets */
+} PBATCH;
+
+/* one pool worker, with its own distance map */
+typedef struct {
+  POOL *pool;
+  DMAP *dm;
+} PBWORKER;
+
+struct pool {
+  GRID *grid;
+  int threads;		/* workers, counting the calling thread */
+  PBWORKER *pw;
+  pthread_t *tids;
+  pthread_mutex_t lock;
+  pthread_cond_t go;	/* a new batch is up, or time to quit */
+  pthread_cond_t idle;	/* the last worker is done with a batch */
+  PBATCH *batch;	/* the batch being run, NULL to quit */
+  unsigned long round;	/* batches handed out so far */
+  int busy;		/* workers still on this round */
+};
+
+static int
+bysource(const void *a, const void *b)
+{
+  const PQUERY *qa = (const PQUERY *)a;
+  const PQUERY *qb = (const PQUERY *)b;
+
+  if(qa->source != qb->source) { return (qa->source < qb->source) ? -1 : 1; }
+  return (qa->query < qb->query) ? -1 : (qa->query > qb->query);
+} /* bysource() */
+
+/* Flood from sources until none are left. A lone query gets a lazy
+ * flood that stops at its target, more than one a full flood.
+ */
+static void
+batchwork(PBATCH *pb, DMAP *dm)
+{
+  int k, q, t, d, from, to, found = 0;
+
+  while((k = __atomic_fetch_add(&pb->taken, 1, __ATOMIC_RELAXED)) <
+  								pb->ngroups) {
+    from = pb->groups[k];
+    to = pb->groups[k + 1];
+
+    if(resetdistancemapbyid(dm, pb->order[from].source) == DISTANCE_ERROR) {
+      for( ; from < to; from ++) {
+        pb->results[pb->order[from].query] = DISTANCE_ERROR;
+      }
+      continue;
+    }
+
+    if(to - from == 1) {
+      q = pb->order[from].query;
+      d = distancetobyid(dm, pb->targets[q], 1);
+      pb->results[q] = (d < 0) ? DISTANCE_ERROR : d;
+      if(d >= 0) { found ++; }
+      continue;
+    }
+
+    distancetobyid(dm, dm->root_id, 0);
+    for( ; from < to; from ++) {
+      q = pb->order[from].query;
+      t = pb->targets[q];
+      if((t >= 0) && (t < dm->msize) && (dm->map[t] >= 0)) {
+	pb->results[q] = dm->map[t];
+	found ++;
+      } else {
+	pb->results[q] = DISTANCE_ERROR;
+      }
+    }
+  }
+
+  __atomic_fetch_add(&pb->found, found, __ATOMIC_RELAXED);
+} /* batchwork() */
+
+/* a pool thread: wait for a batch, work it, repeat until told to quit */
+static void *
+poolworker(void *arg)
+{
+  PBWORKER *pw = (PBWORKER *)arg;
+  POOL *pool = pw->pool;
+  PBATCH *pb;
+  unsigned long seen = 0;
+
+  for(;;) {
+    pthread_mutex_lock(&pool->lock);
+    while(pool->round == seen) {
+      pthread_cond_wait(&pool->go, &pool->lock);
+    }
+    seen = pool->round;
+    pb = pool->batch;
+    pthread_mutex_unlock(&pool->lock);
+
+    if(!pb) { return NULL; }
+    batchwork(pb, pw->dm);
+
+    pthread_mutex_lock(&pool->lock);
+    if(!--pool->busy) { pthread_cond_signal(&pool->idle); }
+    pthread_mutex_unlock(&pool->lock);
+  }
+} /* poolworker() */
+
+POOL *
+createpool(GRID *g, int threads)
+{
+  POOL *pool;
+  int k;
+
+  if(!g) { return NULL; }
+  if(threads < 1) { threads = defaultthreads(); }
+  if(threads > PARALLEL_MAXTHREADS) { threads = PARALLEL_MAXTHREADS; }
+
+  pool = (POOL *)malloc( sizeof(POOL) );
+  if(!pool) { return NULL; }
+  pool->grid = g;
+  pool->pw = (PBWORKER *)malloc( threads * sizeof(PBWORKER) );
+  pool->tids = (pthread_t *)malloc( threads * sizeof(pthread_t) );
+  if(!pool->pw || !pool->tids) {
+    if(pool->pw) { free(pool->pw); }
+    if(pool->tids) { free(pool->tids); }
+    free(pool);
+    return NULL;
+  }
+
+  for(k = 0; k < threads; k ++) {
+    pool->pw[k].pool = pool;
+    pool->pw[k].dm = createdistancemap(g, visitid(g, 0));
+    if(!pool->pw[k].dm) { break; }
+  }
+  if(!k) {
+    free(pool->pw);
+    free(pool->tids);
+    free(pool);
+    return NULL;
+  }
+  threads = k;
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->go, NULL);
+  pthread_cond_init(&pool->idle, NULL);
+  pool->batch = NULL;
+  pool->round = 0;
+  pool->busy = 0;
+
+  /* the calling thread is worker 0, and makes do if others fail */
+  for(k = 1; k < threads; k ++) {
+    if(pthread_create(&pool->tids[k], NULL, poolworker, &pool->pw[k])) {
+      break;
+    }
+  }
+  for(pool->threads = k; k < threads; k ++) {
+    freedistancemap(pool->pw[k].dm);
+  }
+
+  return pool;
+} /* createpool() */
+
+void
+freepool(POOL *pool)
+{
+  if(!pool) { return; }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->batch = NULL;
+  pool->round ++;
+  pthread_cond_broadcast(&pool->go);
+  pthread_mutex_unlock(&pool->lock);
+
+  for(int k = 1; k < pool->threads; k ++) {
+    pthread_join(pool->tids[k], NULL);
+  }
+  for(int k = 0; k < pool->threads; k ++) {
+    freedistancemap(pool->pw[k].dm);
+  }
+  pthread_cond_destroy(&pool->go);
+  pthread_cond_destroy(&pool->idle);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->pw);
+  free(pool->tids);
+  free(pool);
+} /* freepool() */
+
+int
+poolthreads(POOL *pool)
+{
+  return pool ? pool->threads : 0;
+} /* poolthreads() */
+
+int
+batchdistances(POOL *pool, int n, int *sources, int *targets, int *results)
+{
+  PBATCH pb;
+  int k;
+
+  if(!pool || !sources || !targets || !results) { return DISTANCE_ERROR; }
+  if(n <= 0) { return 0; }
+
+  pb.targets = targets;
+  pb.results = results;
+  pb.order = (PQUERY *)malloc( n * sizeof(PQUERY) );
+  pb.groups = (int *)malloc( (n + 1) * sizeof(int) );
+  if(!pb.order || !pb.groups) {
+    if(pb.order) { free(pb.order); }
+    if(pb.groups) { free(pb.groups); }
+    return DISTANCE_ERROR;
+  }
+
+  for(k = 0; k < n; k ++) {
+    pb.order[k].source = sources[k];
+    pb.order[k].query = k;
+  }
+  qsort(pb.order, n, sizeof(PQUERY), bysource);
+  pb.ngroups = 0;
+  for(k = 0; k < n; k ++) {
+    if(!k || (pb.order[k].source != pb.order[k-1].source)) {
+      pb.groups[pb.ngroups++] = k;
+    }
+  }
+  pb.groups[pb.ngroups] = n;
+  pb.taken = 0;
+  pb.found = 0;
+
+  /* the floods read connections by id, not through CELLs */
+  syncgrid(pool->grid);
+
+  /* one group is left to the calling thread, no need to wake others */
+  if((pool->threads > 1) && (pb.ngroups > 1)) {
+    pthread_mutex_lock(&pool->lock);
+    pool->batch = &pb;
+    pool->busy = pool->threads - 1;
+    pool->round ++;
+    pthread_cond_broadcast(&pool->go);
+    pthread_mutex_unlock(&pool->lock);
+
+    batchwork(&pb, pool->pw[0].dm);
+
+    pthread_mutex_lock(&pool->lock);
+    while(pool->busy) {
+      pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+  } else {
+    batchwork(&pb, pool->pw[0].dm);
+  }
+
+  free(pb.order);
+  free(pb.groups);
+
+  return pb.found;
+} /* batchdistances() */
+
+/* shared state of one parallel maze run */
+typedef struct {
+  GRID *g;
+  uint64_t seed;
+  int sidewinder;	/* else binary tree */
+  int taken;		/* rows handed out so far */
+} PMAZE;
+
+/* One row of a binary tree maze, as btreewalker() does it: the top
+ * row runs east, the east column north, other cells flip a coin.
+ */
+static void
+btreerow(GRID *g, int row, uint64_t *state)
+{
+  int id = row * g->cols;
+  int go;
+
+  for(int j = 0; j < g->cols; j ++, id ++) {
+    if(row == 0) {
+      if(j == g->cols - 1) { continue; }
+      go = EAST;
+    } else if(j == g->cols - 1) {
+      go = NORTH;
+    } else {
+      go = fastbelow(state, 2) ? EAST : NORTH;
+    }
+    connectbyid(g, id, go, id + ((go == EAST) ? 1 : -g->cols), SYMMETRICAL);
+  }
+} /* btreerow() */
+
+/* One row of a sidewinder maze, as sidewinderwalker() does it: runs
+ * of cells joined east, each run closed at random by one path north
+ * from a random cell in it. The top row is one run with no way north.
+ */
+static void
+sidewinderrow(GRID *g, int row, uint64_t *state)
+{
+  int id = row * g->cols;
+  int start = 0;
+  int up;
+
+  for(int j = 0; j < g->cols; j ++, id ++) {
+    if(row == 0) {
+      if(j < g->cols - 1) { connectbyid(g, id, EAST, id + 1, SYMMETRICAL); }
+      continue;
+    }
+    if((j == g->cols - 1) || fastbelow(state, 2)) {
+      up = row * g->cols + start +
+	   (int)fastbelow(state, j - start + 1);
+      connectbyid(g, up, NORTH, up - g->cols, SYMMETRICAL);
+      start = j + 1;
+    } else {
+      connectbyid(g, id, EAST, id + 1, SYMMETRICAL);
+    }
+  }
+} /* sidewinderrow() */
+
+/* Make rows until none are left. A row only writes its own cells'
+ * east and west links and the south links of the row above, which
+ * no other row touches, so rows need no locking.
+ */
+static void *
+mazeworker(void *arg)
+{
+  PMAZE *pm = (PMAZE *)arg;
+  uint64_t state;
+  int row, end;
+
+  while((row = __atomic_fetch_add(&pm->taken, PARALLEL_ROWS,
+  				__ATOMIC_RELAXED)) < pm->g->rows) {
+    end = row + PARALLEL_ROWS;
+    if(end > pm->g->rows) { end = pm->g->rows; }
+    for( ; row < end; row ++) {
+      state = faststream(pm->seed, row);
+      if(pm->sidewinder) {
+        sidewinderrow(pm->g, row, &state);
+      } else {
+        btreerow(pm->g, row, &state);
+      }
+    }
+  }
+  return NULL;
+} /* mazeworker() */
+
+static int
+parallelmaze(GRID *g, uint64_t seed, int threads, int sidewinder)
+{
+  PMAZE pm;
+  pthread_t *tids;
+  int k, started;
+
+  if(!g) { return -1; }
+
+  if(threads < 1) { threads = defaultthreads(); }
+  if(threads > PARALLEL_MAXTHREADS) { threads = PARALLEL_MAXTHREADS; }
+  k = (g->rows + PARALLEL_ROWS - 1) / PARALLEL_ROWS;
+  if(threads > k) { threads = k; }
+
+  pm.g = g;
+  pm.seed = seed;
+  pm.sidewinder = sidewinder;
+  pm.taken = 0;
+
+  /* rows are carved by id, not through CELLs */
+  syncgrid(g);
+
+  tids = (pthread_t *)malloc( threads * sizeof(pthread_t) );
+  if(!tids) { threads = 1; }
+
+  /* the calling thread is worker 0, and makes do if others fail */
+  for(started = 1; started < threads; started ++) {
+    if(pthread_create(&tids[started], NULL, mazeworker, &pm)) {
+      break;
+    }
+  }
+  mazeworker(&pm);
+  for(k = 1; k < started; k ++) { pthread_join(tids[k], NULL); }
+
+  if(tids) { free(tids); }
+  return 0;
+} /* parallelmaze() */
+
+int
+parallelbtree(GRID *g, uint64_t seed, int threads)
+{
+  return parallelmaze(g, seed, threads, 0);
+} /* parallelbtree() */
+
+int
+parallelsidewinder(GRID *g, uint64_t seed, int threads)
+{
+  return parallelmaze(g, seed, threads, 1);
+} /* parallelsidewinder() */
+
+/* shared state of one paralleltiles() run */
+typedef struct {
+  GRID *g;
+  uint64_t seed;
+  int algorithm;
+  int th, tw;		/* tile size, last row and column of tiles clipped */
+  int trows, tcols;	/* tiles down and across */
+  int taken;		/* tiles handed out so far */
+} PTILES;
+
+/* one worker's scratch space, big enough for a whole tile */
+typedef struct {
+  PTILES *pt;
+  MAZEAREA area;
+} PTWORKER;
+
+/* a perfect maze in one tile, from the tile's own random stream */
+static void
+maketile(PTWORKER *pw, int tile)
+{
+  PTILES *pt = pw->pt;
+  MAZEAREA *a = &pw->area;
+
+  a->r0 = (tile / pt->tcols) * pt->th;
+  a->c0 = (tile % pt->tcols) * pt->tw;
+  a->h = (a->r0 + pt->th > a->g->rows) ? a->g->rows - a->r0 : pt->th;
+  a->w = (a->c0 + pt->tw > a->g->cols) ? a->g->cols - a->c0 : pt->tw;
+  a->rng = faststream(pt->seed, tile);
+  memset(a->seen, 0, (size_t)(a->h * a->w));
+
+  switch(pt->algorithm) {
+    case TILES_ALDBRO:      aldbroarea(a, 0); break;
+    case TILES_WILSON:      wilsonarea(a); break;
+    default:                backtrackarea(a); break;
+  }
+} /* maketile() */
+
+/* Make tiles until none are left. Tiles only link cells inside
+ * themselves, and on GRID_PACKED grids are whole bitplane words wide,
+ * so no two threads ever write the same memory.
+ */
+static void *
+tileworker(void *arg)
+{
+  PTWORKER *pw = (PTWORKER *)arg;
+  int tile;
+
+  while((tile = __atomic_fetch_add(&pw->pt->taken, 1, __ATOMIC_RELAXED)) <
+  					pw->pt->trows * pw->pt->tcols) {
+    maketile(pw, tile);
+  }
+  return NULL;
+} /* tileworker() */
+
+/* find the tree a tile is in, halving the path, for stitchtiles() */
+static int
+findtile(int *parent, int t)
+{
+  while(parent[t] != t) {
+    parent[t] = parent[parent[t]];
+    t = parent[t];
+  }
+  return t;
+} /* findtile() */
+
+/* Join the tiles with a random spanning tree over the tile grid,
+ * Kruskal style, opening one random wall along each border in it.
+ */
+static int
+stitchtiles(PTILES *pt)
+{
+  GRID *g = pt->g;
+  uint64_t state = faststream(pt->seed, -1);
+  int ntiles = pt->trows * pt->tcols;
+  int *edges, *parent;
+  int ne, e, k, t, a, b, r, c, span;
+
+  edges = (int *)malloc( 2 * ntiles * sizeof(int) );
+  parent = (int *)malloc( ntiles * sizeof(int) );
+  if(!edges || !parent) {
+    if(edges) { free(edges); }
+    if(parent) { free(parent); }
+    return -1;
+  }
+
+  /* a border is a tile number times two, plus one for its south side */
+  ne = 0;
+  for(t = 0; t < ntiles; t ++) {
+    parent[t] = t;
+    if(t % pt->tcols < pt->tcols - 1) { edges[ne++] = 2 * t; }
+    if(t / pt->tcols < pt->trows - 1) { edges[ne++] = 2 * t + 1; }
+  }
+  for(e = ne - 1; e > 0; e --) {
+    k = (int)fastbelow(&state, e + 1);
+    t = edges[e];
+    edges[e] = edges[k];
+    edges[k] = t;
+  }
+
+  for(e = 0; e < ne; e ++) {
+    t = edges[e] / 2;
+    a = findtile(parent, t);
+    b = findtile(parent, t + ((edges[e] & 1) ? pt->tcols : 1));
+    if(a == b) { continue; }
+    parent[b] = a;
+
+    r = (t / pt->tcols) * pt->th;
+    c = (t % pt->tcols) * pt->tw;
+    if(edges[e] & 1) {
+      span = (c + pt->tw > g->cols) ? g->cols - c : pt->tw;
+      c += (int)fastbelow(&state, span);
+      r += pt->th - 1;
+      connectbyid(g, r * g->cols + c, SOUTH, (r + 1) * g->cols + c, SYMMETRICAL);
+    } else {
+      span = (r + pt->th > g->rows) ? g->rows - r : pt->th;
+      r += (int)fastbelow(&state, span);
+      c += pt->tw - 1;
+      connectbyid(g, r * g->cols + c, EAST, r * g->cols + c + 1, SYMMETRICAL);
+    }
+  }
+
+  free(edges);
+  free(parent);
+  return 0;
+} /* stitchtiles() */
+
+int
+paralleltiles(GRID *g, int algorithm, int tile, uint64_t seed, int threads)
+{
+  PTILES pt;
+  PTWORKER *pw;
+  pthread_t *tids;
+  int k, area, started;
+
+  if(!g) { return -1; }
+  if((algorithm != TILES_ALDBRO) && (algorithm != TILES_WILSON) &&
+     (algorithm != TILES_BACKTRACKER)) {
+    return -1;
+  }
+  if(tile < 1) { tile = PARALLEL_TILE; }
+
+  pt.g = g;
+  pt.seed = seed;
+  pt.algorithm = algorithm;
+  pt.th = tile;
+  pt.tw = tile;
+  /* packed tiles get whole words of the bitplanes to themselves */
+  if(g->layout == GRID_PACKED) { pt.tw = (tile + 63) / 64 * 64; }
+  if(pt.th > g->rows) { pt.th = g->rows; }
+  if(pt.tw > g->cols) { pt.tw = g->cols; }
+  pt.trows = (g->rows + pt.th - 1) / pt.th;
+  pt.tcols = (g->cols + pt.tw - 1) / pt.tw;
+  pt.taken = 0;
+  area = pt.th * pt.tw;
+
+  if(threads < 1) { threads = defaultthreads(); }
+  if(threads > PARALLEL_MAXTHREADS) { threads = PARALLEL_MAXTHREADS; }
+  if(threads > pt.trows * pt.tcols) { threads = pt.trows * pt.tcols; }
+
+  /* tiles are carved by id, not through CELLs */
+  syncgrid(g);
+
+  pw = (PTWORKER *)calloc( threads, sizeof(PTWORKER) );
+  tids = (pthread_t *)malloc( threads * sizeof(pthread_t) );
+  if(!pw || !tids) {
+    threads = 0;
+  }
+  for(k = 0; k < threads; k ++) {
+    pw[k].pt = &pt;
+    pw[k].area.g = g;
+    pw[k].area.seen = (unsigned char *)malloc( area );
+    pw[k].area.exits = (unsigned char *)malloc( area );
+    pw[k].area.stack = (uint32_t *)malloc( area * sizeof(uint32_t) );
+    pw[k].area.cap = area;
+    if(!pw[k].area.seen || !pw[k].area.exits || !pw[k].area.stack) {
+      free(pw[k].area.seen);
+      free(pw[k].area.exits);
+      free(pw[k].area.stack);
+      break;
+    }
+  }
+  threads = k;
+
+  if(threads) {
+    /* the calling thread is worker 0, and makes do if others fail */
+    for(started = 1; started < threads; started ++) {
+      if(pthread_create(&tids[started], NULL, tileworker, &pw[started])) {
+	break;
+      }
+    }
+    tileworker(&pw[0]);
+    for(k = 1; k < started; k ++) { pthread_join(tids[k], NULL); }
+  }
+
+  for(k = 0; k < threads; k ++) {
+    free(pw[k].area.seen);
+    free(pw[k].area.exits);
+    free(pw[k].area.stack);
+  }
+  if(pw) { free(pw); }
+  if(tids) { free(tids); }
+
+  if(!threads) { return -1; }
+  return stitchtiles(&pt);
+} /* paralleltiles() */
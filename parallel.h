@@ -0,0 +1,85 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+/* multithreaded distance and maze tools, link with -pthread */
+
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+#include "grid.h"
+#include "distance.h"
+
+#define PARALLEL_MAXTHREADS	64
+
+/* frontier cells a thread takes at a time, and the size of each
+ * thread's local list of new cells before they're added to the
+ * shared next frontier
+ */
+#define PARALLEL_CHUNK		256
+#define PARALLEL_LOCAL		1024
+
+/* frontiers smaller than this are expanded by the calling thread */
+#define PARALLEL_SERIAL		1024
+
+/* grid rows a thread takes at a time when making a maze */
+#define PARALLEL_ROWS		16
+
+/* default tile edge for paralleltiles(), and its tile mazes */
+#define PARALLEL_TILE		256
+#define TILES_ALDBRO		0
+#define TILES_WILSON		1
+#define TILES_BACKTRACKER	2
+
+/* number of threads to use when asked for 0: one per online cpu */
+int defaultthreads(void);
+
+/* distanceto() split over threads, same results and return values.
+ * Cells at equal distance may be in a different order, so farthest_id
+ * may be a different, equally far, cell.
+ */
+int paralleldistanceto(DMAP *, CELL *, int /* lazy flag */, int /* threads */);
+
+/* Worker threads for batchdistances(), each with a distance map for
+ * the grid, kept waiting between batches so a run of batches starts
+ * threads and makes maps once. The calling thread counts as one of
+ * them. The grid's size should not change while the pool is in use.
+ * No part of this structure is intended to be seen by users.
+ */
+typedef struct pool POOL;
+
+/* threads 0 for one per cpu; NULL on failure. If some threads won't
+ * start, the pool makes do with fewer, see poolthreads().
+ */
+POOL *createpool(GRID *, int /* threads */);
+void freepool(POOL *);
+int poolthreads(POOL *);
+
+/* Distances for a batch of queries, sources[i] to targets[i] by cell
+ * id, put in results[i]: DISTANCE_ERROR if unreachable. Queries are
+ * grouped by source so each source is flooded once, and the groups
+ * shared out over the pool's threads. Returns how many were reachable.
+ * One batch at a time per pool.
+ */
+int batchdistances(POOL *, int /* queries */, int * /* sources */,
+		int * /* targets */, int * /* results */);
+
+/* Binary tree and sidewinder mazes, like iterategrid() with
+ * btreewalker() or sidewinderwalker(), with rows shared out over
+ * threads. Each row draws from its own random stream, started from
+ * the seed and the row number, so a seed gives the same maze with
+ * any number of threads. Returns 0, or -1 for no grid.
+ */
+int parallelbtree(GRID *, uint64_t /* seed */, int /* threads */);
+int parallelsidewinder(GRID *, uint64_t /* seed */, int /* threads */);
+
+/* A perfect maze made a tile at a time over threads: the grid is cut
+ * into tile by tile squares (on GRID_PACKED, as wide as whole words of
+ * the bitplanes), each gets its own maze from one of the TILES_
+ * algorithms, then a random spanning tree over the tiles picks which
+ * neighbors to join, through one random wall each. Tile seams are
+ * more walled than a one piece maze would be. Random streams go by
+ * tile, so a seed gives the same maze with any thread count. Leaves
+ * ctype alone. Returns 0, or -1 on bad arguments or failed mallocs.
+ */
+int paralleltiles(GRID *, int /* algorithm */, int /* tile */,
+		uint64_t /* seed */, int /* threads */);
+
+#endif
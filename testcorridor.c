@@ -0,0 +1,160 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+/* testing the corridor contracted graph */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mazes.h"
+#include "corridor.h"
+
+/* compare corridorto() with distanceto() between random cells, and
+ * check each path is connected step by step; returns 0 if all agree
+ */
+int
+crosscheck(GRID *g, CGRAPH *cg, int tries, int report)
+{
+  DMAP *bfs, *other;
+  CELL *from, *to;
+  int want, got, d;
+  long seen = 0, popped = 0;
+
+  bfs = createdistancemap(g, visitid(g, 0));
+  other = createdistancemap(g, visitid(g, 0));
+  if(!bfs || !other) { return 1; }
+  if(tries & 1) { trackparents(other); }
+
+  for(int t = 0; t < tries; t ++) {
+    from = visitrandom(g);
+    to = visitrandom(g);
+    resetdistancemap(bfs, from);
+    resetdistancemap(other, from);
+    want = distanceto(bfs, to, 1);
+    got = corridorto(cg, other, to);
+    if(want != got) {
+      printf("from %d to %d: wanted %d, got %d\n", from->id, to->id, want, got);
+      return 1;
+    }
+    if(want < 0) { continue; }
+    if((findpath(other) != 0) || (other->pathlen != want + 1)) {
+      printf("from %d to %d: bad path\n", from->id, to->id);
+      return 1;
+    }
+    for(int k = 1; k < other->pathlen; k ++) {
+      for(d = FIRSTDIR; d < FOURDIRECTIONS; d ++) {
+        if(linkbyid(g, other->steps[k-1], d) == other->steps[k]) { break; }
+      }
+      if(d == FOURDIRECTIONS) {
+        printf("from %d to %d: path broken at step %d\n", from->id, to->id, k);
+	return 1;
+      }
+    }
+    for(int id = 0; id < g->max; id ++) {
+      if(bfs->map[id] >= 0) { seen ++; }
+    }
+    popped += cg->popped;
+  }
+  if(report) {
+    printf("%d cells, %d nodes; per query distanceto saw %ld cells,"
+    	   " corridorto popped %ld nodes\n", g->max, cg->nodes,
+	   seen / tries, popped / tries);
+  }
+  freedistancemap(bfs);
+  freedistancemap(other);
+  return 0;
+}
+
+/* build the graph and crosscheck, returns 0 if all is well */
+int
+trygrid(char *label, GRID *g, int tries)
+{
+  CGRAPH *cg;
+  int rc;
+
+  cg = createcorridors(g);
+  if(!cg) {
+    printf("%s: createcorridors failed\n", label);
+    return 1;
+  }
+  printf("%s: ", label);
+  rc = crosscheck(g, cg, tries, 1);
+  if(rc) {
+    printf("%s: corridorto disagrees with distanceto()\n", label);
+  }
+  freecorridors(cg);
+  return rc;
+}
+
+int
+main(int notused, char**ignored)
+{
+  GRID *g;
+  CGRAPH *cg;
+  DMAP *dm;
+  char *board;
+  sw_tree_status stats;
+
+  g = creategrid(40,60,UNVISITED);
+  aldbro(g);
+  if(trygrid("aldbro", g, 301)) { return 1; }
+  freegrid(g);
+
+  g = creategridlayout(40,60,1,GRID_PACKED);
+  stats.runlength = 0;
+  iterategrid(g, sidewinderwalker, &stats);
+  if(trygrid("sidewinder", g, 300)) { return 1; }
+  freegrid(g);
+
+  g = creategridlayout(40,60,UNVISITED,GRID_SPLIT);
+  wilson(g);
+  syncgrid(g);
+  for(int w = 0; w < 200; w ++) {
+    int id = visitrandom(g)->id, d = (w & 1) ? EAST : SOUTH;
+    int n = nextid(g, id, d);
+    if(n != NC) { connectbyid(g, id, d, n, opposite(d)); }
+  }
+  if(trygrid("braided", g, 301)) { return 1; }
+  freegrid(g);
+
+  g = creategrid(12,9,1);
+  iterategrid(g, hollow, NULL);
+  if(trygrid("hollow", g, 101)) { return 1; }
+  freegrid(g);
+
+  /* a ring with no junctions or dead ends at all, and a 2x2 block
+   * of no connections next to it
+   */
+  g = creategrid(4,4,1);
+  for(int j = 0; j < 3; j ++) {
+    connectbyid(g, j, EAST, j + 1, WEST);
+    connectbyid(g, 12 + j, EAST, 13 + j, WEST);
+    connectbyid(g, 4 * j, SOUTH, 4 * j + 4, NORTH);
+    connectbyid(g, 4 * j + 3, SOUTH, 4 * j + 7, NORTH);
+  }
+  if(trygrid("ring", g, 101)) { return 2; }
+  freegrid(g);
+  printf("corridorto agrees with distanceto()\n");
+
+  g = creategrid(5,5,1);
+  iterategrid(g, serpentine, NULL);
+  cg = createcorridors(g);
+  dm = createdistancemap(g, visitid(g, 12));
+  if(!cg || !dm || (corridorto(cg, dm, visitid(g, 24)) < 0) || findpath(dm)) {
+    printf("corridorto failed on serpentine\n");
+    return 3;
+  }
+  namepath(dm, "STA", NULL, "END");
+  board = ascii_grid(g, 1);
+  puts(board);
+  free(board);
+  if(strcmp(visitid(g, 24)->name, "END")) {
+    printf("namepath didn't label the end\n");
+    return 3;
+  }
+  freedistancemap(dm);
+  freecorridors(cg);
+  freegrid(g);
+  printf("corridorto paths can be named\n");
+
+  return 0;
+}
@@ -3,8 +3,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "mazes.h"
+#include "testhelp.h"
 
 /* This uses two non-random "maze" structures for test.
  *
@@ -54,6 +56,195 @@ printpath(TRAIL *walk, int max)
   return 0;
 }
 
+/* how many cells a search put a distance on */
+int
+countseen(DMAP *dm)
+{
+  int seen = 0;
+  for(int m = 0; m < dm->msize; m ++) {
+    if(dm->map[m] >= 0) { seen ++; }
+  }
+  return seen;
+}
+
+/* longest shortest path the slow way, a flood from every cell */
+int
+slowlongest(GRID *g)
+{
+  DMAP *dm;
+  CELL *c;
+  int longest = 0;
+
+  dm = createdistancemap(g, visitid(g, 0));
+  if(!dm) { return -1; }
+  for(int id = 0; id < g->max; id ++) {
+    c = visitid(g, id);
+    resetdistancemap(dm, c);
+    distanceto(dm, c, 0);
+    if(dm->farthest > longest) { longest = dm->farthest; }
+  }
+  freedistancemap(dm);
+  return longest;
+}
+
+/* knock out some random walls, making loops */
+void
+braid(GRID *g, int walls)
+{
+  int id, d, n;
+
+  syncgrid(g);
+  for(int w = 0; w < walls; w ++) {
+    id = visitrandom(g)->id;
+    d = (w & 1) ? EAST : SOUTH;
+    n = nextid(g, id, d);
+    if(n != NC) { connectbyid(g, id, d, n, opposite(d)); }
+  }
+}
+
+/* crosscheck() wants two argument solvers */
+int
+lazyhybrid(DMAP *dm, CELL *c)
+{
+  return hybriddistanceto(dm, c, 1);
+}
+
+int
+lazywave(DMAP *dm, CELL *c)
+{
+  return wavedistanceto(dm, c, 1);
+}
+
+/* Dijkstra with a binary heap, to check weighteddistanceto() against
+ * and to time it against. Fills dist, returns the cells reached.
+ */
+int
+heapweighted(GRID *g, int root, int *dist)
+{
+  int *hd, *hc;
+  int len = 0, reached = 0, u, d, v, nd, i, up, kid;
+
+  hd = malloc( (4 * g->max + 1) * sizeof(int) );
+  hc = malloc( (4 * g->max + 1) * sizeof(int) );
+  if(!hd || !hc) { return -1; }
+  for(i = 0; i < g->max; i ++) { dist[i] = NV; }
+
+  dist[root] = 0;
+  hd[0] = 0; hc[0] = root; len = 1;
+  while(len) {
+    d = hd[0]; u = hc[0];
+    /* pop: sift the last entry down from the top */
+    len --;
+    for(i = 0; (kid = 2 * i + 1) < len; i = kid) {
+      if((kid + 1 < len) && (hd[kid + 1] < hd[kid])) { kid ++; }
+      if(hd[len] <= hd[kid]) { break; }
+      hd[i] = hd[kid]; hc[i] = hc[kid];
+    }
+    hd[i] = hd[len]; hc[i] = hc[len];
+    if(d > dist[u]) { continue; }
+    reached ++;
+
+    for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+      v = linkbyid(g, u, go);
+      if(v == NC) { continue; }
+      nd = d + weightbyid(g, v);
+      if((dist[v] != NV) && (dist[v] <= nd)) { continue; }
+      dist[v] = nd;
+      for(i = len ++; i > 0; i = up) {
+        up = (i - 1) / 2;
+        if(hd[up] <= nd) { break; }
+	hd[i] = hd[up]; hc[i] = hc[up];
+      }
+      hd[i] = nd; hc[i] = v;
+    }
+  }
+  free(hd);
+  free(hc);
+  return reached;
+}
+
+/* compare weighteddistanceto() with heapweighted() from a cell, and
+ * a lazy flood and path to another; returns 0 if all agree
+ */
+int
+checkweighted(GRID *g, CELL *from, CELL *to, int report)
+{
+  DMAP *dm;
+  int *dist;
+  clock_t th, tb;
+  int rc = 0, cost;
+
+  dm = createdistancemap(g, from);
+  dist = malloc( g->max * sizeof(int) );
+  if(!dm || !dist) { return 1; }
+
+  th = clock();
+  heapweighted(g, from->id, dist);
+  th = clock() - th;
+  tb = clock();
+  weighteddistanceto(dm, from, 0);
+  tb = clock() - tb;
+
+  for(int id = 0; id < g->max; id ++) {
+    if(dm->map[id] != dist[id]) {
+      printf("cell %d: binary heap %d, buckets %d\n", id, dist[id], dm->map[id]);
+      rc = 1;
+      break;
+    }
+    if((dist[id] > dm->farthest) || (dm->map[dm->farthest_id] != dm->farthest)) {
+      printf("weighted farthest is wrong\n");
+      rc = 1;
+      break;
+    }
+  }
+
+  /* the path should cost what the map says */
+  resetdistancemap(dm, from);
+  if(!rc && (weighteddistanceto(dm, to, 1) == dist[to->id])) {
+    if(findpath(dm)) {
+      rc = 1;
+    } else {
+      cost = 0;
+      for(int k = 1; k < dm->pathlen; k ++) {
+        cost += weightbyid(g, dm->steps[k]);
+      }
+      if(cost != dist[to->id]) { rc = 1; }
+    }
+    if(rc) { printf("weighted path is wrong\n"); }
+  } else if(!rc && (dist[to->id] != NV)) {
+    printf("lazy weighted flood got the wrong distance\n");
+    rc = 1;
+  }
+
+  if(report) {
+    printf("%d cells: binary heap %.3fs, buckets %.3fs\n", g->max,
+    	(double)th / CLOCKS_PER_SEC, (double)tb / CLOCKS_PER_SEC);
+  }
+  free(dist);
+  freedistancemap(dm);
+  return rc;
+}
+
+/* shortest paths by walking every one of them back from id, marking
+ * the cells they use; only for small grids
+ */
+uint64_t
+slowcount(DMAP *dm, int id, char *mark)
+{
+  uint64_t n = 0;
+  int v;
+
+  mark[id] = 1;
+  if(id == dm->root_id) { return 1; }
+  for(int go = FIRSTDIR; go < FOURDIRECTIONS; go ++) {
+    v = linkbyid(dm->grid, id, go);
+    if((v != NC) && (dm->map[v] == dm->map[id] - 1)) {
+      n += slowcount(dm, v, mark);
+    }
+  }
+  return n;
+}
+
 int
 main(int notused, char**ignored)
 {
@@ -61,7 +252,7 @@ main(int notused, char**ignored)
   CELL *c;
   DMAP *dm;
   char *board;
-  int distance;
+  int distance, want;
   int rc;
 
   g = creategrid(10,10,1);
@@ -104,6 +295,54 @@ main(int notused, char**ignored)
     return 1;
   }
 
+  /* same map, other way around */
+  rc = resetdistancemap(dm, visitid(g,99));
+  distance = distanceto(dm, visitid(g,9), 1);
+  if((rc != 0) || (distance != 99) || (dm->path != NULL)) {
+    printf("Reused distance map failed %d\n", distance);
+    return 1;
+  }
+  printf("Reused distance map distance is correctly %d\n", distance);
+  rc = findpath(dm);
+  if((rc != 0) || (dm->pathlen != 100) || (dm->steps[0] != 99) ||
+     (dm->steps[99] != 9) || (dm->path[99].cell_id != 9)) {
+    printf("Reused distance map path failed %d\n", rc);
+    return 1;
+  }
+
+  /* again, following parents */
+  trackparents(dm);
+  resetdistancemap(dm, visitid(g,90));
+  distance = distanceto(dm, visitid(g,0), 1);
+  rc = findpath(dm);
+  if((distance != 81) || (rc != 0) || (dm->pathlen != 82) ||
+     (dm->steps[1] != 80) || printpath(dm->path, 83)) {
+    printf("Parent path failed %d %d\n", distance, rc);
+    return 1;
+  }
+  printf("Parent path is correctly %d steps\n", dm->pathlen);
+
+  freedistancemap(dm);
+  freegrid(g);
+
+  g = creategridlayout(10,10,1,GRID_PACKED);
+  if(!g) {
+    printf("Create packed serpentine grid failed.\n");
+    return 1;
+  }
+  iterategrid(g, serpentine, NULL);
+  dm = createdistancemap(g, visitid(g,9) );
+  distance = distanceto(dm, visitid(g,99), 1);
+  if(distance != 99) {
+    printf("Find packed distance failed %d\n", distance);
+    return 1;
+  }
+  rc = findpath(dm);
+  if( rc != 0 ) {
+    printf("Find packed path failed %d\n", rc);
+    return 1;
+  }
+  printf("Packed distance is correctly %d\n", distance);
   freedistancemap(dm);
   freegrid(g);
 
@@ -147,6 +386,16 @@ main(int notused, char**ignored)
     return 2;
   }
 
+  /* the far corner of a wide grid, back to the root */
+  resetdistancemap(dm, visitid(g, g->cols - 1));
+  distance = distanceto(dm, visitid(g, (g->rows - 1) * g->cols), 1);
+  rc = findpath(dm);
+  if((rc != 0) || (dm->pathlen != g->cols + g->rows - 1)) {
+    printf("Find path across failed %d\n", rc);
+    return 2;
+  }
+  printf("Path across is correctly %d steps\n", dm->pathlen);
+
   freedistancemap(dm);
   freegrid(g);
 
@@ -272,5 +521,539 @@ main(int notused, char**ignored)
 
   freedistancemap(dm);
   freegrid(g);
+
+  printf("\nA* on a hollow grid.\n");
+  g = creategrid(30,40,1);
+  iterategrid(g, hollow, NULL);
+  dm = createdistancemap(g, visitid(g,0) );
+  distance = astarto(dm, visitid(g, g->max - 1));
+  rc = findpath(dm);
+  if((distance != g->cols + g->rows - 2) || (rc != 0) ||
+     (dm->pathlen != distance + 1)) {
+    printf("A* distance failed %d\n", distance);
+    return 6;
+  }
+  printf("A* distance is correctly %d, looking at %d of %d cells\n",
+  	distance, countseen(dm), g->max);
+  if(countseen(dm) * 4 > g->max) {
+    printf("A* looked at too many cells\n");
+    return 6;
+  }
+  if(crosscheck(g, astarto, 50)) {
+    printf("A* disagrees with distanceto() on hollow grid\n");
+    return 6;
+  }
+  freedistancemap(dm);
+  freegrid(g);
+
+  g = creategrid(25,35,UNVISITED);
+  wilson(g);
+  if(crosscheck(g, astarto, 200)) {
+    printf("A* disagrees with distanceto() on a maze\n");
+    return 6;
+  }
+  freegrid(g);
+
+  g = creategrid(3,3,1);
+  dm = createdistancemap(g, visitid(g,0) );
+  if(astarto(dm, visitid(g,8)) != DISTANCE_ERROR) {
+    printf("A* found a path on a pathless grid\n");
+    return 6;
+  }
+  freedistancemap(dm);
+  freegrid(g);
+  printf("A* agrees with distanceto()\n");
+
+  printf("\nBidirectional search on a serpentine.\n");
+  g = creategrid(20,20,1);
+  iterategrid(g, serpentine, NULL);
+  dm = createdistancemap(g, visitid(g, g->cols - 1) );
+  distance = bidistanceto(dm, visitid(g, g->max - 1));
+  rc = findpath(dm);
+  if((distance != g->max - 1) || (rc != 0) || (dm->pathlen != g->max)) {
+    printf("Bidirectional distance failed %d\n", distance);
+    return 7;
+  }
+  printf("Bidirectional distance is correctly %d\n", distance);
+  freedistancemap(dm);
+  if(crosscheck(g, bidistanceto, 50)) {
+    printf("Bidirectional disagrees with distanceto() on serpentine\n");
+    return 7;
+  }
+  freegrid(g);
+
+  g = creategrid(25,35,UNVISITED);
+  wilson(g);
+  if(crosscheck(g, bidistanceto, 200)) {
+    printf("Bidirectional disagrees with distanceto() on a maze\n");
+    return 7;
+  }
+  freegrid(g);
+
+  g = creategrid(12,9,1);
+  iterategrid(g, hollow, NULL);
+  if(crosscheck(g, bidistanceto, 200)) {
+    printf("Bidirectional disagrees with distanceto() on hollow grid\n");
+    return 7;
+  }
+  freegrid(g);
+
+  g = creategrid(3,3,1);
+  dm = createdistancemap(g, visitid(g,0) );
+  if(bidistanceto(dm, visitid(g,8)) != DISTANCE_ERROR) {
+    printf("Bidirectional found a path on a pathless grid\n");
+    return 7;
+  }
+  freedistancemap(dm);
+  freegrid(g);
+  printf("Bidirectional agrees with distanceto()\n");
+
+  printf("\nOne pass longest path on mazes.\n");
+  for(int t = 0; t < 4; t ++) {
+    DMAP *flood;
+
+    g = creategridlayout(30 + t, 41 - t, UNVISITED, t % 3);
+    aldbro(g);
+    dm = findtreediameter(g);
+    if(!dm || (findpath(dm) != 0) || (dm->pathlen != dm->farthest + 1)) {
+      printf("findtreediameter failed on a maze\n");
+      return 8;
+    }
+    syncgrid(g);
+    for(int k = 1; k < dm->pathlen; k ++) {
+      int d;
+      for(d = FIRSTDIR; d < FOURDIRECTIONS; d ++) {
+        if(linkbyid(g, dm->steps[k-1], d) == dm->steps[k]) { break; }
+      }
+      if(d == FOURDIRECTIONS) {
+        printf("findtreediameter path broken at step %d\n", k);
+	return 8;
+      }
+    }
+
+    /* the classic two floods */
+    flood = createdistancemap(g, visitid(g, 0));
+    distanceto(flood, visitid(g, 0), 0);
+    c = visitid(g, flood->farthest_id);
+    resetdistancemap(flood, c);
+    distanceto(flood, c, 0);
+    if(flood->farthest != dm->farthest) {
+      printf("findtreediameter found %d, floods found %d\n",
+      	dm->farthest, flood->farthest);
+      return 8;
+    }
+    freedistancemap(dm);
+
+    /* findlongestpath() gives the same path with a full map */
+    dm = findlongestpath(g);
+    if(!dm || (dm->farthest != flood->farthest) ||
+       (dm->pathlen != dm->farthest + 1) ||
+       (dm->map[dm->target_id] != dm->farthest)) {
+      printf("findlongestpath disagrees with findtreediameter\n");
+      return 8;
+    }
+    resetdistancemap(flood, visitid(g, dm->root_id));
+    distanceto(flood, visitid(g, dm->root_id), 0);
+    for(int id = 0; id < g->max; id ++) {
+      if(dm->map[id] != flood->map[id]) {
+        printf("findlongestpath map at cell %d is %d, not %d\n", id,
+		dm->map[id], flood->map[id]);
+	return 8;
+      }
+    }
+    printf("longest path of %d agrees on %dx%d maze\n",
+    	dm->farthest, g->rows, g->cols);
+    freedistancemap(flood);
+    freedistancemap(dm);
+    freegrid(g);
+  }
+
+  g = creategrid(12,9,1);
+  iterategrid(g, hollow, NULL);
+  dm = findtreediameter(g);
+  if(dm) {
+    printf("findtreediameter accepted a grid with loops\n");
+    return 8;
+  }
+  dm = findlongestpath(g);
+  if(!dm || (dm->farthest != g->rows + g->cols - 2)) {
+    printf("findlongestpath failed on hollow grid\n");
+    return 8;
+  }
+  freedistancemap(dm);
+  freegrid(g);
+  printf("findtreediameter agrees with two floods\n");
+
+  printf("\nExact longest path on grids with loops.\n");
+  for(int t = 0; t < 6; t ++) {
+    int want;
+
+    g = creategridlayout(14 + t, 19 - t, UNVISITED, t % 3);
+    if(t == 5) {
+      iterategrid(g, hollow, NULL);
+    } else {
+      aldbro(g);
+      braid(g, 10 + 20 * t);
+    }
+    want = slowlongest(g);
+    dm = findlongestpath(g);
+    if(!dm || (dm->farthest != want) || (dm->pathlen != want + 1)) {
+      printf("exact longest path failed, wanted %d\n", want);
+      return 9;
+    }
+    printf("longest path of %d correct on %dx%d grid\n",
+    	want, g->rows, g->cols);
+    freedistancemap(dm);
+    freegrid(g);
+  }
+  printf("findexactlongestpath agrees with flooding everything\n");
+
+  printf("\nDirection optimizing flood.\n");
+  g = creategrid(40,70,1);
+  iterategrid(g, hollow, NULL);
+  if(comparefloods(g, visitid(g, 0), hybriddistanceto) ||
+     comparefloods(g, visitrc(g, 20, 35), hybriddistanceto) ||
+     crosscheck(g, lazyhybrid, 100)) {
+    printf("hybrid flood disagrees on hollow grid\n");
+    return 10;
+  }
+  freegrid(g);
+
+  for(int t = 0; t < 3; t ++) {
+    g = creategridlayout(50 + t, 61, UNVISITED, t);
+    aldbro(g);
+    braid(g, 500 * t);
+    if(comparefloods(g, visitrandom(g), hybriddistanceto) ||
+       crosscheck(g, lazyhybrid, 100)) {
+      printf("hybrid flood disagrees on maze\n");
+      return 10;
+    }
+    freegrid(g);
+  }
+
+  g = creategrid(3,3,1);
+  dm = createdistancemap(g, visitid(g,0) );
+  if(hybriddistanceto(dm, visitid(g,8), 0) != DISTANCE_ERROR) {
+    printf("hybrid flood found a path on a pathless grid\n");
+    return 10;
+  }
+  freedistancemap(dm);
+  freegrid(g);
+
+  g = creategrid(1000,1000,1);
+  iterategrid(g, hollow, NULL);
+  if(comparefloods(g, visitrc(g, 500, 500), hybriddistanceto)) {
+    printf("hybrid flood disagrees on big hollow grid\n");
+    return 10;
+  }
+  freegrid(g);
+  printf("hybriddistanceto agrees with distanceto()\n");
+
+  printf("\nBit parallel flood.\n");
+  g = creategrid(40,70,1);
+  iterategrid(g, hollow, NULL);
+  if(comparefloods(g, visitid(g, 0), wavedistanceto) ||
+     comparefloods(g, visitrc(g, 20, 64), wavedistanceto) ||
+     crosscheck(g, lazywave, 100)) {
+    printf("wave flood disagrees on hollow grid\n");
+    return 11;
+  }
+  freegrid(g);
+
+  for(int t = 0; t < 3; t ++) {
+    g = creategridlayout(50 + t, 130 - t, UNVISITED, t);
+    aldbro(g);
+    braid(g, 500 * t);
+    if(comparefloods(g, visitrandom(g), wavedistanceto) ||
+       crosscheck(g, lazywave, 100)) {
+      printf("wave flood disagrees on maze\n");
+      return 11;
+    }
+    freegrid(g);
+  }
+
+  g = creategridlayout(3,3,1,GRID_PACKED);
+  dm = createdistancemap(g, visitid(g,0) );
+  if(wavedistanceto(dm, visitid(g,8), 0) != DISTANCE_ERROR) {
+    printf("wave flood found a path on a pathless grid\n");
+    return 11;
+  }
+  freedistancemap(dm);
+  freegrid(g);
+
+  for(int t = 0; t < 3; t ++) {
+    g = creategridlayout(30, 90, UNVISITED, t);
+    aldbro(g);
+    braid(g, 200);
+    dm = createdistancemap(g, visitrandom(g));
+    trackparents(dm);
+    wavedistanceto(dm, visitid(g,0), 0);
+    for(int id = 0; id < g->max; id ++) {
+      int p = dm->parent[id], linked = 0;
+      if(id == dm->root_id) { continue; }
+      for(int d = FIRSTDIR; d < FOURDIRECTIONS; d ++) {
+	if(linkbyid(g, id, d) == p) { linked = 1; }
+      }
+      if((dm->map[p] != dm->map[id] - 1) || !linked) {
+	printf("wave flood gave cell %d a bad parent %d\n", id, p);
+	return 11;
+      }
+    }
+    freedistancemap(dm);
+    freegrid(g);
+  }
+
+  /* the copied links are the map's, a changed grid needs a new one */
+  g = creategridlayout(1,3,1,GRID_SPLIT);
+  dm = createdistancemap(g, visitid(g,0) );
+  wavedistanceto(dm, visitid(g,2), 0);
+  connectbyid(g, 0, EAST, 1, WEST);
+  connectbyid(g, 1, EAST, 2, WEST);
+  resetdistancemap(dm, visitid(g,0));
+  if(wavedistanceto(dm, visitid(g,2), 0) != DISTANCE_ERROR) {
+    printf("wave flood saw a change to the grid it copied\n");
+    return 11;
+  }
+  freedistancemap(dm);
+  dm = createdistancemap(g, visitid(g,0) );
+  if((wavedistanceto(dm, visitid(g,2), 0) != 0) || (dm->map[2] != 2)) {
+    printf("wave flood on a new map missed a change to the grid\n");
+    return 11;
+  }
+  freedistancemap(dm);
+  freegrid(g);
+
+  /* one way links, left to distanceto() */
+  g = creategridlayout(1,3,1,GRID_PACKED);
+  connectbyid(g, 0, EAST, 1, WEST);
+  connectbyid(g, 1, EAST, 2, NC);
+  if(comparefloods(g, visitid(g, 0), wavedistanceto) ||
+     comparefloods(g, visitid(g, 2), wavedistanceto)) {
+    printf("wave flood disagrees on one way links\n");
+    return 11;
+  }
+  freegrid(g);
+
+  g = creategridlayout(1000,1000,1,GRID_PACKED);
+  iterategrid(g, hollow, NULL);
+  if(comparefloods(g, visitrc(g, 500, 500), wavedistanceto)) {
+    printf("wave flood disagrees on big hollow grid\n");
+    return 11;
+  }
+  freegrid(g);
+  printf("wavedistanceto agrees with distanceto()\n");
+
+  printf("\nCompact distance maps.\n");
+  for(int t = 0; t < 3; t ++) {
+    DMAP *wide;
+
+    g = creategridlayout(45, 50 + t, UNVISITED, t);
+    aldbro(g);
+    braid(g, 300 * t);
+    c = visitrandom(g);
+    wide = createdistancemap(g, c);
+    dm = createcompactdistancemap(g, c);
+    distanceto(wide, c, 0);
+    distanceto(dm, c, 0);
+    for(int id = 0; id < g->max; id ++) {
+      if(distanceofid(dm, id) != wide->map[id]) {
+        printf("compact map has %d for cell %d, not %d\n",
+		distanceofid(dm, id), id, wide->map[id]);
+	return 12;
+      }
+    }
+    if((dm->farthest != wide->farthest) || !dm->map16 || dm->map) {
+      printf("compact map flood went wrong\n");
+      return 12;
+    }
+    freedistancemap(wide);
+    freedistancemap(dm);
+
+    /* lazy floods, with and without parents */
+    wide = createdistancemap(g, c);
+    dm = createcompactdistancemap(g, c);
+    if(t) { trackparents(dm); }
+    for(int k = 0; k < 50; k ++) {
+      CELL *to = visitrandom(g);
+
+      c = visitrandom(g);
+      resetdistancemap(wide, c);
+      resetdistancemap(dm, c);
+      distance = distanceto(wide, to, 1);
+      if((distanceto(dm, to, 1) != distance) || findpath(dm) ||
+         (dm->pathlen != distance + 1)) {
+	printf("compact map lazy flood went wrong\n");
+	return 12;
+      }
+    }
+    freedistancemap(wide);
+    freedistancemap(dm);
+    freegrid(g);
+  }
+
+  g = creategrid(3,3,1);
+  iterategrid(g, serpentine, NULL);
+  dm = createcompactdistancemap(g, visitid(g,0) );
+  if((distanceto(dm, visitid(g,6), 1) != 6) || findpath(dm) ||
+     namepath(dm, "STA", NULL, "END")) {
+    printf("compact map on serpentine failed\n");
+    return 12;
+  }
+  ascii_dmap(dm);
+  board = ascii_grid(g, 1);
+  puts(board);
+  free(board);
+  /* the solvers that want full maps say so */
+  if((hybriddistanceto(dm, visitid(g,6), 1) != DISTANCE_ERROR) ||
+     (wavedistanceto(dm, visitid(g,6), 1) != DISTANCE_ERROR) ||
+     (astarto(dm, visitid(g,6)) != DISTANCE_ERROR) ||
+     (weighteddistanceto(dm, visitid(g,6), 1) != DISTANCE_ERROR) ||
+     (bidistanceto(dm, visitid(g,6)) != DISTANCE_ERROR)) {
+    printf("a full map solver took a compact map\n");
+    return 12;
+  }
+  freedistancemap(dm);
+  freegrid(g);
+
+  /* long enough to outgrow 16 bits */
+  g = creategridlayout(300,300,1,GRID_PACKED);
+  iterategrid(g, serpentine, NULL);
+  dm = createdistancemap(g, visitid(g,0) );
+  want = distanceto(dm, visitid(g, g->max - 1), 1);
+  freedistancemap(dm);
+  dm = createcompactdistancemap(g, visitid(g,0) );
+  distance = distanceto(dm, visitid(g, g->max - 1), 1);
+  if((distance != want) || (want <= COMPACT_MAXDIST) || dm->map16 ||
+     !dm->map || findpath(dm) || (dm->pathlen != want + 1)) {
+    printf("compact map failed to widen, distance %d\n", distance);
+    return 12;
+  }
+  /* a one cell wide path never needs more than the first frontiers */
+  if(dm->fsize > 64) {
+    printf("compact map frontiers grew to %d on a serpentine\n", dm->fsize);
+    return 12;
+  }
+  freedistancemap(dm);
+  freegrid(g);
+  printf("compact maps agree with distanceto()\n");
+
+  printf("\nWeighted cells.\n");
+  g = creategrid(3,5,1);
+  iterategrid(g, hollow, NULL);
+  /* mud on three cells and lava on one, so the cheap way goes round */
+  setweightbyid(g, 1, 9);
+  setweightbyid(g, 6, 9);
+  setweightbyid(g, 13, 9);
+  setweightbyid(g, 9, 200);
+  dm = createdistancemap(g, visitid(g,0) );
+  if((weighteddistanceto(dm, visitid(g,14), 1) != 14) || findpath(dm) ||
+     (dm->pathlen != 7) || namepath(dm, "STA", NULL, "END")) {
+    printf("weighted flood missed the way round the mud\n");
+    return 13;
+  }
+  ascii_dmap(dm);
+  board = ascii_grid(g, 1);
+  puts(board);
+  free(board);
+  freedistancemap(dm);
+  if((weightbyid(g, 9) != 200) || (weightbyid(g, 2) != 1) ||
+     (setweightbyid(g, 2, GRID_MAXWEIGHT + 1) != -1)) {
+    printf("cell weights went wrong\n");
+    return 13;
+  }
+  freegrid(g);
+
+  /* unweighted, it's just distanceto() */
+  g = creategridlayout(40,50,UNVISITED,GRID_SPLIT);
+  aldbro(g);
+  braid(g, 200);
+  if(comparefloods(g, visitrandom(g), weighteddistanceto)) {
+    printf("weighted flood with no weights disagrees with distanceto()\n");
+    return 13;
+  }
+  for(int t = 0; t < 3; t ++) {
+    for(int id = 0; id < g->max; id ++) {
+      setweightbyid(g, id, (t == 2) ? random() % 4 : 1 + random() % 9);
+    }
+    if(checkweighted(g, visitrandom(g), visitrandom(g), 0)) { return 13; }
+  }
+  freegrid(g);
+
+  g = creategridlayout(1000,1000,UNVISITED,GRID_PACKED);
+  iterategrid(g, hollow, NULL);
+  syncgrid(g);
+  for(int id = 0; id < g->max; id ++) {
+    setweightbyid(g, id, 1 + random() % 9);
+  }
+  if(checkweighted(g, visitrc(g, 500, 500), visitid(g, 0), 1)) { return 13; }
+  freegrid(g);
+  printf("weighteddistanceto agrees with a binary heap\n");
+
+  printf("\nCounting shortest paths.\n");
+  /* corner to corner of an open grid: choose which steps go down */
+  g = creategrid(6,9,1);
+  iterategrid(g, hollow, NULL);
+  dm = createdistancemap(g, visitid(g,0) );
+  distanceto(dm, visitid(g, g->max - 1), 0);
+  if((countpaths(dm) != g->max) || (dm->counts[g->max - 1] != 1287)) {
+    printf("open grid should have 1287 paths through every cell\n");
+    return 14;
+  }
+  freedistancemap(dm);
+  freegrid(g);
+
+  g = creategrid(70,70,1);
+  iterategrid(g, hollow, NULL);
+  dm = createdistancemap(g, visitid(g,0) );
+  distanceto(dm, visitid(g, g->max - 1), 1);
+  if((countpaths(dm) != g->max) || (dm->counts[g->max - 1] != UINT64_MAX)) {
+    printf("path count should saturate\n");
+    return 14;
+  }
+  freedistancemap(dm);
+  freegrid(g);
+
+  /* one way only */
+  g = creategrid(7,5,1);
+  iterategrid(g, serpentine, NULL);
+  dm = createdistancemap(g, visitid(g,0) );
+  distance = distanceto(dm, visitid(g, 22), 1);
+  if((countpaths(dm) != distance + 1) || (dm->counts[22] != 1) ||
+     !onanypath(dm, 5) || onanypath(dm, 30)) {
+    printf("serpentine should have one path\n");
+    return 14;
+  }
+  freedistancemap(dm);
+  freegrid(g);
+
+  for(int t = 0; t < 3; t ++) {
+    char mark[100];
+    uint64_t slow;
+    int on;
+
+    g = creategridlayout(10, 10, UNVISITED, t);
+    aldbro(g);
+    braid(g, 40);
+    for(int k = 0; k < 20; k ++) {
+      c = visitrandom(g);
+      dm = createdistancemap(g, c);
+      distanceto(dm, visitrandom(g), k & 1);
+      memset(mark, 0, sizeof(mark));
+      slow = slowcount(dm, dm->target_id, mark);
+      on = countpaths(dm);
+      for(int id = 0; id < g->max; id ++) {
+        if(mark[id] != onanypath(dm, id)) { on = -1; }
+	if(mark[id]) { on --; }
+      }
+      if(on || (dm->counts[dm->target_id] != slow)) {
+        printf("countpaths disagrees with walking every path\n");
+	return 14;
+      }
+      freedistancemap(dm);
+    }
+    freegrid(g);
+  }
+  printf("countpaths agrees with walking every path\n");
+
   return 0;
 }
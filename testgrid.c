@@ -338,6 +338,150 @@ main(int ignored, char**notused)
     return(7);
   }
 
+  freegrid(g);
+
+  printf("\nNew 5x5 packed grid\n");
+
+  g = creategridlayout(5,5,2,GRID_PACKED);
+  if(!g) {
+    printf("creategridlayout( 5 x 5, packed ) failed.\n");
+    return(8);
+  }
+  c1 = visitrc(g,2,2);
+  if(tryconnect(g, c1, EAST) || tryconnect(g, c1, SOUTH)) {
+    return(8);
+  }
+  c1->ctype = 7;
+
+  /* more cells than views, pushes the middle cell out and back */
+  rc = iterategrid(g, counter, &total);
+  c1 = visitrc(g,2,2);
+  if((c1->ctype != 7) || (wallstatusbycell(c1) != (NORTH_WALL|WEST_WALL))) {
+    printf("Packed middle cell lost changes, wrong.\n");
+    return(8);
+  }
+  c2 = visitrc(g,3,2);
+  if(isconnectedbycell(c2, c1, NORTH) != NORTH) {
+    printf("Packed south cell lost connection, wrong.\n");
+    return(8);
+  }
+  c2 = visitrc(g,2,3);
+  if(visitdir(g, c2, WEST, SYMMETRICAL) != c1) {
+    printf("Packed east cell lost connection, wrong.\n");
+    return(8);
+  }
+  printf("Packed cells survive leaving the views\n");
+  freegrid(g);
+
+  printf("\nOne way links and unlinks on a 4x4 packed grid\n");
+  g = creategridlayout(4,4,2,GRID_PACKED);
+  if(!g) {
+    printf("creategridlayout( 4 x 4, packed ) failed.\n");
+    return(8);
+  }
+  connectbyid(g, 0, EAST, 1, SYMMETRICAL);
+  connectbycell(visitid(g,5), SOUTH, visitid(g,9), SYMMETRICAL);
+  syncgrid(g);
+  if(g->west || (linkbyid(g, 1, WEST) != 0) || (linkbyid(g, 9, NORTH) != 5)) {
+    printf("Packed two way links wrong.\n");
+    return(8);
+  }
+
+  /* one way through a view, and through ids */
+  connectbycell(visitid(g,5), EAST, visitid(g,6), NC);
+  connectbyid(g, 10, NC, 14, NORTH);
+  /* take away both ways of one link, and one way of another */
+  visitid(g,0)->dir[EAST] = NC;
+  visitid(g,1)->dir[WEST] = NC;
+  visitid(g,5)->dir[SOUTH] = NC;
+  syncgrid(g);
+  if((linkbyid(g, 5, EAST) != 6) || (linkbyid(g, 6, WEST) != NC) ||
+     (linkbyid(g, 14, NORTH) != 10) || (linkbyid(g, 10, SOUTH) != NC) ||
+     (linkbyid(g, 0, EAST) != NC) || (linkbyid(g, 1, WEST) != NC) ||
+     (linkbyid(g, 5, SOUTH) != NC) || (linkbyid(g, 9, NORTH) != 5)) {
+    printf("Packed one way links or unlinks lost, wrong.\n");
+    return(8);
+  }
+  printf("Packed links read back as they were made\n");
+  freegrid(g);
+
+  printf("\nNew 3x3 packed grid\n");
+
+  g = creategridlayout(3,3,2,GRID_PACKED);
+  if(!g) {
+    printf("creategridlayout( 3 x 3, packed ) failed.\n");
+    return(8);
+  }
+  c1 = visitrc(g,1,1);
+  printf("Knocking down all walls on middle cell.\n");
+  for(int d = FIRSTDIR; d < FOURDIRECTIONS; d++) {
+    if(tryconnect(g, c1, d)) {
+      return(8);
+    }
+  }
+  namebycell(c1, " X");
+
+  board = ascii_grid(g, 1);
+  puts(board);
+  if(0 == strncmp(board, expectedboard, BUFSIZ)) {
+    printf("Packed ASCII art as expected\n");
+  } else {
+    printf("Packed ASCII art wrong\n");
+    return(8);
+  }
+  free(board);
+
+  freegrid(g);
+
+  printf("\nNew 3x3 split grid\n");
+
+  g = creategridlayout(3,3,2,GRID_SPLIT);
+  if(!g) {
+    printf("creategridlayout( 3 x 3, split ) failed.\n");
+    return(9);
+  }
+  c1 = visitrc(g,1,1);
+  printf("Knocking down all walls on middle cell.\n");
+  for(int d = FIRSTDIR; d < FOURDIRECTIONS; d++) {
+    if(tryconnect(g, c1, d)) {
+      return(9);
+    }
+  }
+  if(g->names) {
+    printf("Split name table made before any names, wrong.\n");
+    return(9);
+  }
+  namebycell(c1, " X");
+  syncgrid(g);
+  if(!g->names || strcmp(getnamebyid(g, c1->id), " X")) {
+    printf("Split name table missing name, wrong.\n");
+    return(9);
+  }
+  if(linkbyid(g, 1, SOUTH) != 4) {
+    printf("Split link by id wrong.\n");
+    return(9);
+  }
+
+  board = ascii_grid(g, 1);
+  puts(board);
+  if(0 == strncmp(board, expectedboard, BUFSIZ)) {
+    printf("Split ASCII art as expected\n");
+  } else {
+    printf("Split ASCII art wrong\n");
+    return(9);
+  }
+  free(board);
+
+  /* by id changes go straight through, and show in views */
+  setctypebyid(g, 4, 9);
+  connectbyid(g, 0, EAST, 1, SYMMETRICAL);
+  c2 = visitid(g, 1);
+  if((c1->ctype != 9) || (isconnectedbycell(c2, visitid(g, 0), WEST) != WEST)) {
+    printf("Split by id changes missing, wrong.\n");
+    return(9);
+  }
+  printf("Split by id changes seen in views\n");
+
   freegrid(g);
   return(0);
 }
@@ -0,0 +1,92 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+/* checks shared by the distance test programs */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "grid.h"
+#include "distance.h"
+#include "testhelp.h"
+
+/* wall clock seconds, clock() would add up every thread's time */
+double
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* compare a solver against distanceto() between random cells of
+ * a grid, returns 0 if all agree
+ */
+int
+crosscheck(GRID *g, int (*solver)(DMAP *, CELL *), int tries)
+{
+  DMAP *bfs, *other;
+  CELL *from, *to;
+  int want, got;
+
+  bfs = createdistancemap(g, visitid(g, 0));
+  other = createdistancemap(g, visitid(g, 0));
+  if(!bfs || !other) { return 1; }
+  trackparents(other);
+
+  for(int t = 0; t < tries; t ++) {
+    from = visitrandom(g);
+    to = visitrandom(g);
+    resetdistancemap(bfs, from);
+    resetdistancemap(other, from);
+    want = distanceto(bfs, to, 1);
+    got = solver(other, to);
+    if(want != got) {
+      printf("from %d to %d: wanted %d, got %d\n", from->id, to->id, want, got);
+      return 1;
+    }
+    if((findpath(other) != 0) || (other->pathlen != want + 1)) {
+      printf("from %d to %d: bad path\n", from->id, to->id);
+      return 1;
+    }
+  }
+  freedistancemap(bfs);
+  freedistancemap(other);
+  return 0;
+}
+
+/* full maps from distanceto() and another flood should match,
+ * returns 0 if they do; big grids print both times
+ */
+int
+comparefloods(GRID *g, CELL *from, int (*flood)(DMAP *, CELL *, int))
+{
+  DMAP *a, *b;
+  double ta, tb;
+  int rc = 0;
+
+  a = createdistancemap(g, from);
+  b = createdistancemap(g, from);
+  if(!a || !b) { return 1; }
+
+  ta = now();
+  distanceto(a, from, 0);
+  ta = now() - ta;
+  tb = now();
+  flood(b, from, 0);
+  tb = now() - tb;
+
+  for(int id = 0; id < g->max; id ++) {
+    if(a->map[id] != b->map[id]) {
+      printf("cell %d: distanceto %d, other %d\n", id, a->map[id], b->map[id]);
+      rc = 1;
+      break;
+    }
+  }
+  if(a->farthest != b->farthest) { rc = 1; }
+  if(g->max > 100000) {
+    printf("%d cells: distanceto %.3fs, other %.3fs\n", g->max, ta, tb);
+  }
+  freedistancemap(a);
+  freedistancemap(b);
+  return rc;
+}
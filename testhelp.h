@@ -0,0 +1,23 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+/* checks shared by the distance test programs */
+
+#ifndef _TESTHELP_H
+#define _TESTHELP_H
+
+#include "grid.h"
+#include "distance.h"
+
+/* wall clock seconds, clock() would add up every thread's time */
+double now(void);
+
+/* compare a solver against distanceto() between random cells of
+ * a grid, returns 0 if all agree
+ */
+int crosscheck(GRID *, int (*)(DMAP *, CELL *), int);
+
+/* full maps from distanceto() and another flood should match,
+ * returns 0 if they do; big grids print both times
+ */
+int comparefloods(GRID *, CELL *, int (*)(DMAP *, CELL *, int));
+
+#endif
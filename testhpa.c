@@ -0,0 +1,276 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+/* testing the hierarchical (HPA*) index */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mazes.h"
+#include "hpa.h"
+
+/* wall clock seconds, clock() would add up every thread's time */
+double
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* compare hpato() with distanceto() between random cells, and check
+ * each path is connected step by step; returns 0 if all agree
+ */
+int
+crosscheck(GRID *g, HPA *h, int tries)
+{
+  DMAP *bfs, *other;
+  CELL *from, *to;
+  int want, got, d;
+
+  bfs = createdistancemap(g, visitid(g, 0));
+  other = createdistancemap(g, visitid(g, 0));
+  if(!bfs || !other) { return 1; }
+  if(tries & 1) { trackparents(other); }
+
+  for(int t = 0; t < tries; t ++) {
+    from = visitrandom(g);
+    to = visitrandom(g);
+    resetdistancemap(bfs, from);
+    resetdistancemap(other, from);
+    want = distanceto(bfs, to, 1);
+    got = hpato(h, other, to);
+    if(want != got) {
+      printf("from %d to %d: wanted %d, got %d\n", from->id, to->id, want, got);
+      return 1;
+    }
+    if(want < 0) { continue; }
+    if((findpath(other) != 0) || (other->pathlen != want + 1)) {
+      printf("from %d to %d: bad path\n", from->id, to->id);
+      return 1;
+    }
+    for(int k = 1; k < other->pathlen; k ++) {
+      for(d = FIRSTDIR; d < FOURDIRECTIONS; d ++) {
+        if(linkbyid(g, other->steps[k-1], d) == other->steps[k]) { break; }
+      }
+      if(d == FOURDIRECTIONS) {
+        printf("from %d to %d: path broken at step %d\n", from->id, to->id, k);
+	return 1;
+      }
+    }
+  }
+  freedistancemap(bfs);
+  freedistancemap(other);
+  return 0;
+}
+
+/* build the index with a few cluster sizes and crosscheck, returns
+ * 0 if all is well
+ */
+int
+trygrid(char *label, GRID *g, int tries)
+{
+  HPA *h;
+  int sizes[] = { 1, 3, 8, 0 };
+
+  for(int s = 0; s < 4; s ++) {
+    h = createhpa(g, sizes[s], 1 + s);
+    if(!h) {
+      printf("%s: createhpa failed\n", label);
+      return 1;
+    }
+    if(crosscheck(g, h, tries)) {
+      printf("%s: hpato with clusters of %d disagrees with distanceto()\n",
+      		label, h->csize);
+      return 1;
+    }
+    freehpa(h);
+  }
+  printf("%s: hpato agrees with distanceto()\n", label);
+  return 0;
+}
+
+/* save an index, overwrite the int at one offset, and see loadhpa()
+ * turn it down; returns 0 if it does
+ */
+int
+corrupt(HPA *h, long at, int value)
+{
+  FILE *fp;
+  HPA *loaded;
+
+  fp = tmpfile();
+  if(!fp || savehpa(h, fp)) { return 1; }
+  fseek(fp, at, SEEK_SET);
+  fwrite(&value, sizeof(int), 1, fp);
+  rewind(fp);
+  loaded = loadhpa(h->grid, fp);
+  fclose(fp);
+  if(loaded) {
+    freehpa(loaded);
+    return 1;
+  }
+  return 0;
+}
+
+int
+main(int notused, char**ignored)
+{
+  GRID *g;
+  HPA *h, *loaded;
+  DMAP *dm;
+  FILE *fp;
+  CELL *from, *to;
+  double start, built[2], bfs, solve;
+  int want, got, tries;
+
+  g = creategrid(40,60,UNVISITED);
+  aldbro(g);
+  if(trygrid("aldbro", g, 201)) { return 1; }
+  freegrid(g);
+
+  g = creategridlayout(37,61,UNVISITED,GRID_PACKED);
+  wilson(g);
+  syncgrid(g);
+  for(int w = 0; w < 200; w ++) {
+    int id = visitrandom(g)->id, d = (w & 1) ? EAST : SOUTH;
+    int n = nextid(g, id, d);
+    if(n != NC) { connectbyid(g, id, d, n, opposite(d)); }
+  }
+  if(trygrid("braided", g, 201)) { return 1; }
+  freegrid(g);
+
+  g = creategridlayout(12,9,1,GRID_SPLIT);
+  iterategrid(g, hollow, NULL);
+  if(trygrid("hollow", g, 101)) { return 1; }
+  freegrid(g);
+
+  /* no connections at all: nothing but the start is reachable */
+  g = creategrid(10,10,1);
+  if(trygrid("unconnected", g, 51)) { return 1; }
+  freegrid(g);
+
+  /* a saved index answers the same as the one it came from */
+  g = creategrid(50,50,UNVISITED);
+  eller(g->rows, g->cols, ellergrid, g);
+  h = createhpa(g, 8, 2);
+  fp = tmpfile();
+  if(!h || !fp || savehpa(h, fp)) {
+    printf("could not save an index\n");
+    return 2;
+  }
+  rewind(fp);
+  loaded = loadhpa(g, fp);
+  fclose(fp);
+  if(!loaded || (loaded->nodes != h->nodes) || (loaded->ends != h->ends) ||
+     memcmp(loaded->weight, h->weight, h->ends * sizeof(int)) ||
+     crosscheck(g, loaded, 101)) {
+    printf("a loaded index doesn't match the saved one\n");
+    return 2;
+  }
+  freehpa(loaded);
+  freehpa(h);
+  freegrid(g);
+
+  g = creategrid(50,51,UNVISITED);
+  eller(g->rows, g->cols, ellergrid, g);
+  h = createhpa(g, 8, 1);
+  fp = tmpfile();
+  if(!h || !fp || savehpa(h, fp)) { return 2; }
+  rewind(fp);
+  freegrid(g);
+  g = creategrid(50,50,UNVISITED);
+  if(loadhpa(g, fp)) {
+    printf("loaded an index for a grid of another size\n");
+    return 2;
+  }
+  fclose(fp);
+  freehpa(h);
+  freegrid(g);
+
+  /* same size, another maze: one wall knocked out */
+  g = creategrid(50,50,UNVISITED);
+  eller(g->rows, g->cols, ellergrid, g);
+  h = createhpa(g, 8, 1);
+  fp = tmpfile();
+  if(!h || !fp || savehpa(h, fp)) { return 2; }
+  rewind(fp);
+  syncgrid(g);
+  for(int id = 0; id < g->max; id ++) {
+    if((linkbyid(g, id, EAST) == NC) && (nextid(g, id, EAST) != NC)) {
+      connectbyid(g, id, EAST, id + 1, WEST);
+      break;
+    }
+  }
+  if(loadhpa(g, fp)) {
+    printf("loaded an index for another maze\n");
+    return 2;
+  }
+  fclose(fp);
+  freehpa(h);
+
+  /* damaged files: header, node, cfirst, first, to and weight
+   * offsets are 4, 28, 28 + 4 * nodes, and so on
+   */
+  h = createhpa(g, 8, 1);
+  if(!h) { return 2; }
+  {
+    long node = 28, cfirst = node + 4 * h->nodes;
+    long first = cfirst + 4 * (h->crows * h->ccols + 1);
+    long to = first + 4 * (h->nodes + 1), weight = to + 4 * h->ends;
+
+    if(corrupt(h, 16, 0) || corrupt(h, 20, h->nodes + 1) ||
+       corrupt(h, node, g->max) || corrupt(h, node + 4, -1) ||
+       corrupt(h, node, h->node[1]) ||
+       corrupt(h, cfirst + 4, h->nodes + 1) || corrupt(h, cfirst, 1) ||
+       corrupt(h, first + 8, 0) || corrupt(h, to, h->nodes) ||
+       corrupt(h, to + 4, -1) || corrupt(h, weight, -2)) {
+      printf("loaded a damaged index\n");
+      return 2;
+    }
+  }
+  freehpa(h);
+  freegrid(g);
+  printf("indexes can be saved and loaded\n");
+
+  /* the point of it: a big maze, solved many times */
+  g = creategrid(1000,1000,UNVISITED);
+  eller(g->rows, g->cols, ellergrid, g);
+  for(int t = 0; t < 2; t ++) {
+    start = now();
+    h = createhpa(g, HPA_CLUSTER, t ? 4 : 1);
+    built[t] = now() - start;
+    if(!h) { return 3; }
+    if(!t) { freehpa(h); }
+  }
+  printf("1000x1000 eller: %d portals, built in %.3fs (1 thread),"
+  	 " %.3fs (4 threads)\n", h->nodes, built[0], built[1]);
+
+  dm = createdistancemap(g, visitid(g, 0));
+  tries = 20;
+  bfs = solve = 0;
+  for(int t = 0; t < tries; t ++) {
+    from = visitrandom(g);
+    to = visitrandom(g);
+    resetdistancemap(dm, from);
+    start = now();
+    want = distanceto(dm, to, 1);
+    bfs += now() - start;
+    resetdistancemap(dm, from);
+    start = now();
+    got = hpato(h, dm, to);
+    solve += now() - start;
+    if(want != got) {
+      printf("from %d to %d: wanted %d, got %d\n", from->id, to->id, want, got);
+      return 3;
+    }
+  }
+  printf("per query: distanceto %.2fms, hpato %.2fms\n",
+  	 1000 * bfs / tries, 1000 * solve / tries);
+  freedistancemap(dm);
+  freehpa(h);
+  freegrid(g);
+
+  return 0;
+}
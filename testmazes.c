@@ -0,0 +1,235 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+/* testing maze generators */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mazes.h"
+
+/* A perfect maze is a spanning tree: exactly one path between any
+ * two cells. That's true if there are (cells - 1) connections and
+ * every cell can be reached from the first.
+ * Returns 0 for a perfect maze.
+ */
+int
+notperfect(GRID *g)
+{
+  DMAP *dm;
+  int links = 0;
+  int rc = 0;
+
+  syncgrid(g);
+  for(int id = 0; id < g->max; id ++) {
+    if(linkbyid(g, id, EAST) != NC) { links ++; }
+    if(linkbyid(g, id, SOUTH) != NC) { links ++; }
+  }
+  if(links != g->max - 1) {
+    printf("%d connections for %d cells\n", links, g->max);
+    return 1;
+  }
+
+  dm = createdistancemap(g, visitid(g, 0));
+  if(!dm) { return 2; }
+  distanceto(dm, visitid(g, g->max - 1), 0);
+  for(int id = 0; id < g->max; id ++) {
+    if(dm->map[id] < 0) {
+      printf("cell %d unreachable\n", id);
+      rc = 3;
+      break;
+    }
+  }
+  freedistancemap(dm);
+  return rc;
+}
+
+/* make a maze with a generator and check it */
+int
+trygenerator(char *label, int (*gen)(GRID *), int rows, int cols, int layout)
+{
+  GRID *g;
+  char *board;
+  int rc;
+
+  g = creategridlayout(rows, cols, UNVISITED, layout);
+  if(!g) {
+    printf("%s: create grid failed\n", label);
+    return 1;
+  }
+  rc = gen(g);
+  if(rc) {
+    printf("%s: generator failed %d\n", label, rc);
+    freegrid(g);
+    return 1;
+  }
+  if(rows * cols < 200) {
+    board = ascii_grid(g, 0);
+    puts(board);
+    free(board);
+  }
+  rc = notperfect(g);
+  freegrid(g);
+  if(rc) {
+    printf("%s: not a perfect maze\n", label);
+    return 1;
+  }
+  printf("%s: %d x %d perfect maze\n", label, rows, cols);
+  return 0;
+}
+
+int
+halfandhalf(GRID *g)
+{
+  return aldbrowilson(g, 50);
+}
+
+int
+mostlywilson(GRID *g)
+{
+  return aldbrowilson(g, ALDBROWILSON_PERCENT);
+}
+
+/* growing tree flavors */
+int
+growbacktrack(GRID *g)
+{
+  return growingtree(g, 1, 0, 0);
+}
+
+int
+growprim(GRID *g)
+{
+  return growingtree(g, 0, 1, 0);
+}
+
+int
+growoldest(GRID *g)
+{
+  return growingtree(g, 0, 0, 1);
+}
+
+int
+growmixed(GRID *g)
+{
+  return growingtree(g, 3, 1, 1);
+}
+
+/* eller() call back that both carves a grid and writes ASCII art */
+typedef struct { GRID *g; FILE *fp; } both;
+
+int
+ellerboth(MAZEROW *mr, void *param)
+{
+  both *b = (both *)param;
+
+  if(ellergrid(mr, b->g)) { return -1; }
+  return ellerascii(mr, b->fp);
+}
+
+/* stop an endless eller() after a few rows */
+int
+ellerstop(MAZEROW *mr, void *param)
+{
+  int *rows = (int *)param;
+
+  if(mr->last) { return -1; }
+  (*rows) ++;
+  return (mr->row == 999);
+}
+
+int
+tryeller(int rows, int cols)
+{
+  both b;
+  char *board, *streamed;
+  long len;
+  int rc;
+
+  b.g = creategrid(rows, cols, UNVISITED);
+  b.fp = tmpfile();
+  if(!b.g || !b.fp) {
+    printf("eller: setup failed\n");
+    return 1;
+  }
+  rc = eller(rows, cols, ellerboth, &b);
+  if(rc) {
+    printf("eller: generator failed %d\n", rc);
+    return 1;
+  }
+  if(notperfect(b.g)) {
+    printf("eller: not a perfect maze\n");
+    return 1;
+  }
+
+  board = ascii_grid(b.g, 0);
+  len = ftell(b.fp);
+  streamed = (char *)calloc(1, (size_t)len + 1);
+  rewind(b.fp);
+  if(!board || !streamed || (fread(streamed, 1, len, b.fp) != (size_t)len)) {
+    printf("eller: reading back failed\n");
+    return 1;
+  }
+  if(strcmp(board, streamed)) {
+    printf("eller: streamed ASCII art differs from grid\n");
+    puts(streamed);
+    puts(board);
+    return 1;
+  }
+  if(rows * cols < 200) {
+    puts(streamed);
+  }
+  printf("eller: %d x %d perfect maze, streamed art matches\n", rows, cols);
+
+  free(board);
+  free(streamed);
+  fclose(b.fp);
+  freegrid(b.g);
+  return 0;
+}
+
+int
+main(int notused, char**ignored)
+{
+  GRID *g;
+  int endless = 0;
+
+  if(trygenerator("aldbro", aldbro, 8, 12, GRID_CELLS)) { return 1; }
+  if(trygenerator("wilson", wilson, 8, 12, GRID_CELLS)) { return 2; }
+  if(trygenerator("wilson", wilson, 1, 1, GRID_CELLS)) { return 2; }
+  if(trygenerator("wilson", wilson, 100, 130, GRID_PACKED)) { return 2; }
+  if(trygenerator("aldbrowilson", halfandhalf, 8, 12, GRID_SPLIT)) { return 3; }
+  if(trygenerator("aldbrowilson", mostlywilson, 90, 70, GRID_CELLS)) { return 3; }
+  if(trygenerator("kruskal", kruskal, 8, 12, GRID_CELLS)) { return 5; }
+  if(trygenerator("kruskal", kruskal, 1, 1, GRID_PACKED)) { return 5; }
+  if(trygenerator("kruskal", kruskal, 1, 40, GRID_SPLIT)) { return 5; }
+  if(trygenerator("kruskal", kruskal, 150, 170, GRID_PACKED)) { return 5; }
+  if(trygenerator("growingtree newest", growbacktrack, 8, 12, GRID_CELLS)) { return 6; }
+  if(trygenerator("growingtree random", growprim, 8, 12, GRID_SPLIT)) { return 6; }
+  if(trygenerator("growingtree oldest", growoldest, 8, 12, GRID_PACKED)) { return 6; }
+  if(trygenerator("growingtree mixed", growmixed, 1, 1, GRID_CELLS)) { return 6; }
+  if(trygenerator("growingtree mixed", growmixed, 120, 90, GRID_PACKED)) { return 6; }
+  if(trygenerator("backtracker", backtracker, 8, 12, GRID_CELLS)) { return 7; }
+  if(trygenerator("backtracker", backtracker, 1, 1, GRID_SPLIT)) { return 7; }
+  if(trygenerator("backtracker", backtracker, 1, 3000, GRID_PACKED)) { return 7; }
+  if(trygenerator("backtracker", backtracker, 700, 900, GRID_PACKED)) { return 7; }
+
+  g = creategrid(2,2,UNVISITED);
+  if(!growingtree(NULL, 1, 0, 0) || !growingtree(g, 0, 0, 0) ||
+     !growingtree(g, 1, -1, 1)) {
+    printf("growingtree: took bad weights\n");
+    return 6;
+  }
+  freegrid(g);
+
+  if(tryeller(8, 12)) { return 4; }
+  if(tryeller(1, 5)) { return 4; }
+  if(tryeller(6, 1)) { return 4; }
+  if(tryeller(60, 90)) { return 4; }
+  if((eller(0, 30, ellerstop, &endless) != 1) || (endless != 1000)) {
+    printf("eller: endless maze didn't stop at 1000 rows, %d\n", endless);
+    return 4;
+  }
+  printf("eller: endless maze stopped on request\n");
+
+  return 0;
+}
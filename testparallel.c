@@ -0,0 +1,353 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+/* testing the multithreaded distance tools */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "mazes.h"
+#include "parallel.h"
+#include "testhelp.h"
+
+/* crosscheck() and comparefloods() pass no thread count */
+int nthreads;
+
+int
+parallelflood(DMAP *dm, CELL *c, int lazy)
+{
+  return paralleldistanceto(dm, c, lazy, nthreads);
+}
+
+int
+lazyparallel(DMAP *dm, CELL *c)
+{
+  return paralleldistanceto(dm, c, 1, nthreads);
+}
+
+/* full maps from distanceto() and paralleldistanceto() with a range
+ * of thread counts, returns 0 if they all match
+ */
+int
+floodthreads(GRID *g, CELL *from, int report)
+{
+  for(nthreads = 1; nthreads <= 8; nthreads *= 2) {
+    if(report) {
+      printf("  %d thread%s\n", nthreads, (nthreads == 1) ? "" : "s");
+    }
+    if(comparefloods(g, from, parallelflood)) {
+      printf("%d threads: maps differ\n", nthreads);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* lazy paralleldistanceto() against distanceto() between random cells */
+int
+threadcheck(GRID *g, int threads, int tries)
+{
+  nthreads = threads;
+  return crosscheck(g, lazyparallel, tries);
+}
+
+/* batchdistances() against one distanceto() per query, sources
+ * picked from a few cells so most are shared, returns 0 if all agree
+ */
+int
+checkbatch(POOL *pool, GRID *g, int n, int nsources, int report)
+{
+  DMAP *dm;
+  int *sources, *targets, *results, *pick;
+  int want, found, rc = 0;
+  double ta, tb;
+
+  sources = malloc( n * sizeof(int) );
+  targets = malloc( n * sizeof(int) );
+  results = malloc( n * sizeof(int) );
+  pick = malloc( nsources * sizeof(int) );
+  if(!sources || !targets || !results || !pick) { return 1; }
+
+  for(int k = 0; k < nsources; k ++) { pick[k] = visitrandom(g)->id; }
+  for(int k = 0; k < n; k ++) {
+    sources[k] = pick[random() % nsources];
+    targets[k] = visitrandom(g)->id;
+  }
+  /* and some nonsense */
+  sources[0] = -1;
+  targets[n - 1] = g->max;
+
+  tb = now();
+  found = batchdistances(pool, n, sources, targets, results);
+  tb = now() - tb;
+
+  dm = createdistancemap(g, visitid(g, 0));
+  ta = now();
+  for(int k = 0; k < n; k ++) {
+    if((sources[k] < 0) || (targets[k] >= g->max)) {
+      want = DISTANCE_ERROR;
+    } else {
+      resetdistancemap(dm, visitid(g, sources[k]));
+      want = distanceto(dm, visitid(g, targets[k]), 1);
+    }
+    if(want >= 0) { found --; }
+    if(want != results[k]) {
+      printf("query %d, %d to %d: wanted %d, got %d\n", k,
+      		sources[k], targets[k], want, results[k]);
+      rc = 1;
+      break;
+    }
+  }
+  ta = now() - ta;
+  if(found) {
+    printf("batchdistances found count off by %d\n", found);
+    rc = 1;
+  }
+  if(report) {
+    printf("%d queries from %d sources, %d threads: batch %.3fs, one by one %.3fs\n",
+    	n, nsources, poolthreads(pool), tb, ta);
+  }
+
+  freedistancemap(dm);
+  free(sources);
+  free(targets);
+  free(results);
+  free(pick);
+  return rc;
+}
+
+/* Make a maze with the same seed and 1 to 8 threads, checking each is
+ * perfect and the same as the first. Returns 0 if all is well.
+ */
+int
+checkmaze(int rows, int cols, int layout,
+	int (*gen)(GRID *, uint64_t, int), int report)
+{
+  GRID *first, *g;
+  DMAP *dm;
+  double t, one = 0;
+  int links;
+
+  first = NULL;
+  for(int threads = 1; threads <= 8; threads *= 2) {
+    g = creategridlayout(rows, cols, UNVISITED, layout);
+    if(!g) { return 1; }
+    t = now();
+    gen(g, 0x5eed + rows, threads);
+    t = now() - t;
+    if(threads == 1) { one = t; }
+    if(report) {
+      printf("  %d thread%s %.3fs, speedup %.2f\n", threads,
+      		(threads == 1) ? " " : "s", t, one / t);
+    }
+
+    if(!first) {
+      /* a spanning tree: cells - 1 links, every cell reached */
+      links = 0;
+      for(int id = 0; id < g->max; id ++) {
+	if(linkbyid(g, id, EAST) != NC) { links ++; }
+	if(linkbyid(g, id, SOUTH) != NC) { links ++; }
+      }
+      dm = createdistancemap(g, visitid(g, 0));
+      distanceto(dm, visitid(g, 0), 0);
+      for(int id = 0; id < g->max; id ++) {
+        if(dm->map[id] < 0) { links = -1; }
+      }
+      freedistancemap(dm);
+      if(links != g->max - 1) {
+        printf("%d x %d: not a perfect maze\n", rows, cols);
+	return 1;
+      }
+      first = g;
+      continue;
+    }
+
+    for(int id = 0; id < g->max; id ++) {
+      for(int d = FIRSTDIR; d < FOURDIRECTIONS; d ++) {
+        if(linkbyid(g, id, d) != linkbyid(first, id, d)) {
+	  printf("%d x %d: %d threads made a different maze\n",
+	  	 rows, cols, threads);
+	  return 1;
+	}
+      }
+    }
+    freegrid(g);
+  }
+  freegrid(first);
+  return 0;
+}
+
+/* paralleltiles() flavors for checkmaze(), small tiles so there are
+ * plenty of seams and clipped tiles
+ */
+int
+tilealdbro(GRID *g, uint64_t seed, int threads)
+{
+  return paralleltiles(g, TILES_ALDBRO, 13, seed, threads);
+}
+
+int
+tilewilson(GRID *g, uint64_t seed, int threads)
+{
+  return paralleltiles(g, TILES_WILSON, 20, seed, threads);
+}
+
+int
+tilebacktracker(GRID *g, uint64_t seed, int threads)
+{
+  return paralleltiles(g, TILES_BACKTRACKER, 9, seed, threads);
+}
+
+int
+bigtiles(GRID *g, uint64_t seed, int threads)
+{
+  return paralleltiles(g, TILES_WILSON, 0, seed, threads);
+}
+
+int
+main(int notused, char**ignored)
+{
+  GRID *g;
+  DMAP *dm;
+  POOL *pool;
+  double ta;
+
+  printf("%d cpus online\n", defaultthreads());
+
+  g = creategrid(40,70,1);
+  iterategrid(g, hollow, NULL);
+  if(floodthreads(g, visitid(g, 0), 0) ||
+     floodthreads(g, visitrc(g, 20, 35), 0) ||
+     threadcheck(g, 4, 100)) {
+    printf("parallel flood disagrees on hollow grid\n");
+    return 1;
+  }
+  freegrid(g);
+
+  for(int t = 0; t < 3; t ++) {
+    g = creategridlayout(50 + t, 61, UNVISITED, t);
+    aldbro(g);
+    if(floodthreads(g, visitrandom(g), 0) || threadcheck(g, 3, 100)) {
+      printf("parallel flood disagrees on maze\n");
+      return 1;
+    }
+    freegrid(g);
+  }
+  printf("paralleldistanceto agrees with distanceto()\n");
+
+  g = creategrid(3,3,1);
+  dm = createdistancemap(g, visitid(g,0) );
+  if(paralleldistanceto(dm, visitid(g,8), 0, 4) != DISTANCE_ERROR) {
+    printf("parallel flood found a path on a pathless grid\n");
+    return 2;
+  }
+  freedistancemap(dm);
+  freegrid(g);
+
+  g = creategrid(1,1,1);
+  dm = createdistancemap(g, visitid(g,0) );
+  if((paralleldistanceto(dm, visitid(g,0), 0, 4) != 0) ||
+     (dm->farthest != 0) || findpath(dm)) {
+    printf("parallel flood failed on a micro grid\n");
+    return 2;
+  }
+  freedistancemap(dm);
+  freegrid(g);
+  printf("paralleldistanceto handles odd grids\n");
+
+  g = creategridlayout(60,80,UNVISITED,GRID_PACKED);
+  aldbro(g);
+  /* pools are used for several batches, and one thread is allowed */
+  for(int threads = 1; threads < 5; threads += 3) {
+    pool = createpool(g, threads);
+    if(!pool || (poolthreads(pool) != threads)) {
+      printf("createpool failed\n");
+      return 4;
+    }
+    if(checkbatch(pool, g, 200, 7, 0) || checkbatch(pool, g, 50, 50, 0) ||
+       checkbatch(pool, g, 1, 1, 0) || checkbatch(pool, g, 300, 2, 0)) {
+      printf("batchdistances disagrees on maze\n");
+      return 4;
+    }
+    freepool(pool);
+  }
+  freegrid(g);
+
+  g = creategrid(8,8,1);
+  pool = createpool(g, 2);
+  if(!pool || checkbatch(pool, g, 30, 3, 0)) {
+    printf("batchdistances disagrees on pathless grid\n");
+    return 4;
+  }
+  freepool(pool);
+  freegrid(g);
+  printf("batchdistances agrees with distanceto()\n");
+
+  for(int t = 0; t < 3; t ++) {
+    if(checkmaze(37, 45, t, parallelbtree, 0) ||
+       checkmaze(1, 20, t, parallelbtree, 0) ||
+       checkmaze(20, 1, t, parallelbtree, 0) ||
+       checkmaze(70, 130 + t, t, parallelsidewinder, 0) ||
+       checkmaze(1, 1, t, parallelsidewinder, 0) ||
+       checkmaze(20, 1, t, parallelsidewinder, 0)) {
+      printf("parallel maze went wrong\n");
+      return 5;
+    }
+  }
+  for(int t = 0; t < 3; t ++) {
+    if(checkmaze(57, 150, t, tilealdbro, 0) ||
+       checkmaze(40, 41, t, tilewilson, 0) ||
+       checkmaze(100, 130, t, tilebacktracker, 0) ||
+       checkmaze(1, 1, t, tilewilson, 0) ||
+       checkmaze(5, 300, t, tilebacktracker, 0)) {
+      printf("tiled maze went wrong\n");
+      return 6;
+    }
+  }
+  printf("parallel mazes are perfect and the same for any thread count\n");
+
+  printf("\nScaling on a hollow grid.\n");
+  g = creategridlayout(1000,1000,1,GRID_SPLIT);
+  iterategrid(g, hollow, NULL);
+  if(floodthreads(g, visitrc(g, 500, 500), 1) || threadcheck(g, 4, 10)) {
+    printf("parallel flood disagrees on big hollow grid\n");
+    return 3;
+  }
+  freegrid(g);
+
+  printf("\nScaling on a maze.\n");
+  g = creategridlayout(1000,1000,UNVISITED,GRID_SPLIT);
+  eller(1000, 1000, ellergrid, g);
+  if(floodthreads(g, visitid(g, 0), 1)) {
+    printf("parallel flood disagrees on big maze\n");
+    return 3;
+  }
+  freegrid(g);
+
+  printf("\nMaking a maze.\n");
+  g = creategridlayout(2000,2000,UNVISITED,GRID_PACKED);
+  ta = now();
+  iterategrid(g, btreewalker, NULL);
+  printf("4000000 cells, btreewalker %.3fs, parallelbtree\n", now() - ta);
+  freegrid(g);
+  if(checkmaze(2000, 2000, GRID_PACKED, parallelbtree, 1)) { return 5; }
+
+  g = creategridlayout(2000,2000,UNVISITED,GRID_SPLIT);
+  ta = now();
+  wilson(g);
+  printf("4000000 cells, wilson %.3fs, paralleltiles\n", now() - ta);
+  freegrid(g);
+  if(checkmaze(2000, 2000, GRID_SPLIT, bigtiles, 1)) { return 6; }
+
+  printf("\nBatch on a maze.\n");
+  g = creategridlayout(500,500,UNVISITED,GRID_SPLIT);
+  eller(500, 500, ellergrid, g);
+  pool = createpool(g, 4);
+  if(!pool || checkbatch(pool, g, 200, 10, 1)) {
+    printf("batchdistances disagrees on big maze\n");
+    return 4;
+  }
+  freepool(pool);
+  freegrid(g);
+
+  return 0;
+}
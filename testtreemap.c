@@ -0,0 +1,125 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+/* testing the tree distance oracle */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mazes.h"
+#include "treemap.h"
+
+/* compare treedistance() and treepath() with distanceto() between
+ * random cells, returns 0 if all agree
+ */
+int
+crosscheck(GRID *g, TREEMAP *tm, int tries)
+{
+  DMAP *dm;
+  CELL *from, *to;
+  int *steps;
+  int want, got, len;
+
+  dm = createdistancemap(g, visitid(g, 0));
+  steps = (int *)malloc(g->max * sizeof(int));
+  if(!dm || !steps) { return 1; }
+
+  for(int t = 0; t < tries; t ++) {
+    from = visitrandom(g);
+    to = visitrandom(g);
+    resetdistancemap(dm, from);
+    want = distanceto(dm, to, 1);
+    got = treedistance(tm, from->id, to->id);
+    if(want != got) {
+      printf("from %d to %d: wanted %d, got %d\n", from->id, to->id, want, got);
+      return 1;
+    }
+
+    len = treepath(tm, from->id, to->id, steps);
+    if((len != want + 1) || (steps[0] != from->id) || (steps[len-1] != to->id)) {
+      printf("from %d to %d: bad path ends\n", from->id, to->id);
+      return 1;
+    }
+    for(int k = 1; k < len; k ++) {
+      if(isconnectedbyid(g, steps[k-1], steps[k], ANYDIR) == NC) {
+        printf("from %d to %d: path breaks at step %d\n", from->id, to->id, k);
+	return 1;
+      }
+    }
+  }
+  free(steps);
+  freedistancemap(dm);
+  return 0;
+}
+
+int
+main(int notused, char**ignored)
+{
+  GRID *g;
+  TREEMAP *tm;
+  int steps[4];
+
+  g = creategrid(40,55,UNVISITED);
+  wilson(g);
+  tm = createtreemap(g, visitrandom(g));
+  if(!tm) {
+    printf("createtreemap failed on a perfect maze\n");
+    return 1;
+  }
+  if(tm->tourlen != 2 * g->max - 1) {
+    printf("Euler tour is %d long, not %d\n", tm->tourlen, 2 * g->max - 1);
+    return 1;
+  }
+  if(crosscheck(g, tm, 500)) {
+    printf("treemap disagrees with distanceto()\n");
+    return 1;
+  }
+  printf("treemap agrees with distanceto() on a %d x %d maze\n",
+  	g->rows, g->cols);
+  freetreemap(tm);
+  freegrid(g);
+
+  g = creategrid(30,30,1);
+  iterategrid(g, serpentine, NULL);
+  tm = createtreemap(g, visitid(g, 0));
+  if(!tm || crosscheck(g, tm, 200)) {
+    printf("treemap failed on serpentine\n");
+    return 2;
+  }
+  printf("treemap agrees with distanceto() on serpentine\n");
+  freetreemap(tm);
+  freegrid(g);
+
+  g = creategrid(4,4,1);
+  iterategrid(g, hollow, NULL);
+  tm = createtreemap(g, visitid(g, 0));
+  if(tm) {
+    printf("createtreemap should refuse a grid with loops\n");
+    return 3;
+  }
+  printf("createtreemap correctly refused a grid with loops\n");
+  freegrid(g);
+
+  g = creategrid(3,3,1);
+  connectbyid(g, 0, EAST, 1, SYMMETRICAL);
+  tm = createtreemap(g, visitid(g, 0));
+  if(!tm || (treedistance(tm, 1, 0) != 1) ||
+     (treedistance(tm, 0, 8) != DISTANCE_NOPATH) ||
+     (treepath(tm, 1, 0, steps) != 2) || (steps[1] != 0)) {
+    printf("treemap failed on a mostly pathless grid\n");
+    return 4;
+  }
+  printf("treemap handles unreachable cells\n");
+  freetreemap(tm);
+  freegrid(g);
+
+  g = creategrid(1,1,1);
+  tm = createtreemap(g, visitid(g, 0));
+  if(!tm || (treedistance(tm, 0, 0) != 0) || (treepath(tm, 0, 0, steps) != 1)) {
+    printf("treemap failed on a micro grid\n");
+    return 5;
+  }
+  printf("treemap handles a micro grid\n");
+  freetreemap(tm);
+  freegrid(g);
+
+  return 0;
+}
@@ -0,0 +1,250 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+/* distance oracle for perfect (tree) mazes */
+
+#include <stdlib.h>
+
+#include "grid.h"
+#include "distance.h"
+#include "treemap.h"
+
+/* of two euler tour indexes, the one of the shallower cell */
+static int
+shallower(TREEMAP *tm, int i, int j)
+{
+  return (tm->depth[tm->euler[j]] < tm->depth[tm->euler[i]]) ? j : i;
+} /* shallower() */
+
+/* Depth first walk of the tree from the root, with an explicit stack,
+ * writing the Euler tour: every cell when first reached, and its
+ * parent again each time the walk comes back up. Returns non-zero
+ * if a cell is reached a second way, ie the maze has a loop.
+ */
+static int
+eulertour(TREEMAP *tm)
+{
+  GRID *g = tm->grid;
+  int *stack;
+  unsigned char *tried;
+  int top, u, v, go;
+
+  stack = (int *)malloc(tm->msize * sizeof(int));
+  tried = (unsigned char *)malloc((size_t)tm->msize);
+  if(!stack || !tried) {
+    free(stack);
+    free(tried);
+    return -1;
+  }
+
+  syncgrid(g);
+
+  u = tm->root_id;
+  tm->depth[u] = 0;
+  tm->parent[u] = NC;
+  tm->first[u] = 0;
+  tm->euler[0] = u;
+  tm->tourlen = 1;
+  tried[u] = FIRSTDIR;
+  stack[0] = u;
+  top = 0;
+
+  while(top >= 0) {
+    u = stack[top];
+    go = tried[u];
+    if(go == FOURDIRECTIONS) {
+      /* done here, back up */
+      top --;
+      if(top >= 0) { tm->euler[tm->tourlen++] = stack[top]; }
+      continue;
+    }
+    tried[u] ++;
+
+    v = linkbyid(g, u, go);
+    if((v < 0) || (v >= tm->msize) || (v == tm->parent[u])) { continue; }
+    if(tm->depth[v] != NV) {
+      free(stack);
+      free(tried);
+      return -1;
+    }
+
+    tm->depth[v] = tm->depth[u] + 1;
+    tm->parent[v] = u;
+    tm->first[v] = tm->tourlen;
+    tm->euler[tm->tourlen++] = v;
+    tried[v] = FIRSTDIR;
+    stack[++top] = v;
+  }
+
+  free(stack);
+  free(tried);
+  return 0;
+} /* eulertour() */
+
+/* Builds the index for a perfect maze, or any grid where the cells
+ * reachable from the root form a tree. Cells not reachable get
+ * depth NV, and distances to them are DISTANCE_NOPATH.
+ * Time and memory are linear in the number of cells.
+ */
+TREEMAP *
+createtreemap(GRID *g, CELL *c)
+{
+  TREEMAP *tm;
+  int b, k, i, end;
+
+  if(!g) { return NULL; }
+  if(!c) { return NULL; }
+
+  tm = (TREEMAP *)calloc(1, sizeof(TREEMAP));
+  if(!tm) { return NULL; }
+
+  tm->grid = g;
+  tm->root_id = c->id;
+  tm->msize = g->max;
+
+  tm->depth = malloc( g->max * sizeof(int) );
+  tm->parent = malloc( g->max * sizeof(int) );
+  tm->first = malloc( g->max * sizeof(int) );
+  tm->euler = malloc( 2 * g->max * sizeof(int) );
+  if(!tm->depth || !tm->parent || !tm->first || !tm->euler) {
+    freetreemap(tm);
+    return NULL;
+  }
+
+  for (int m = 0; m < g->max; m++) {
+    tm->depth[m] = NV;
+    tm->parent[m] = NC;
+    tm->first[m] = NC;
+  }
+
+  if(eulertour(tm)) {
+    freetreemap(tm);
+    return NULL;
+  }
+
+  /* sparse table of block minimums */
+  tm->blocks = (tm->tourlen + TREEMAP_BLOCK - 1) / TREEMAP_BLOCK;
+  for(tm->levels = 1; (1 << tm->levels) <= tm->blocks; tm->levels ++) { }
+
+  tm->sparse = malloc( (size_t)tm->levels * tm->blocks * sizeof(int) );
+  if(!tm->sparse) {
+    freetreemap(tm);
+    return NULL;
+  }
+
+  for(b = 0; b < tm->blocks; b ++) {
+    i = b * TREEMAP_BLOCK;
+    end = i + TREEMAP_BLOCK;
+    if(end > tm->tourlen) { end = tm->tourlen; }
+    tm->sparse[b] = i;
+    for(i ++; i < end; i ++) {
+      tm->sparse[b] = shallower(tm, tm->sparse[b], i);
+    }
+  }
+  for(k = 1; k < tm->levels; k ++) {
+    int *row = tm->sparse + k * tm->blocks;
+    int *prev = row - tm->blocks;
+    int half = 1 << (k - 1);
+
+    for(b = 0; b + (1 << k) <= tm->blocks; b ++) {
+      row[b] = shallower(tm, prev[b], prev[b + half]);
+    }
+  }
+
+  return tm;
+} /* createtreemap() */
+
+void
+freetreemap(TREEMAP *tm)
+{
+  if(!tm) { return; }
+  if(tm->depth) { free(tm->depth); }
+  if(tm->parent) { free(tm->parent); }
+  if(tm->first) { free(tm->first); }
+  if(tm->euler) { free(tm->euler); }
+  if(tm->sparse) { free(tm->sparse); }
+  free(tm);
+} /* freetreemap() */
+
+/* lowest common ancestor: the shallowest cell in the Euler tour
+ * between the first visits of the two cells. Returns NC if either
+ * cell isn't in the tree.
+ */
+int
+treelca(TREEMAP *tm, int id1, int id2)
+{
+  int i, j, bi, bj, best, end;
+
+  if(!tm) { return NC; }
+  if((id1 < 0) || (id1 >= tm->msize)) { return NC; }
+  if((id2 < 0) || (id2 >= tm->msize)) { return NC; }
+  if((tm->depth[id1] == NV) || (tm->depth[id2] == NV)) { return NC; }
+
+  i = tm->first[id1];
+  j = tm->first[id2];
+  if(i > j) { int swap = i; i = j; j = swap; }
+
+  bi = i / TREEMAP_BLOCK;
+  bj = j / TREEMAP_BLOCK;
+
+  best = i;
+  if(bi == bj) {
+    for(i ++; i <= j; i ++) { best = shallower(tm, best, i); }
+    return tm->euler[best];
+  }
+
+  /* tail of first block, head of last block */
+  end = (bi + 1) * TREEMAP_BLOCK;
+  for(i ++; i < end; i ++) { best = shallower(tm, best, i); }
+  for(i = bj * TREEMAP_BLOCK; i <= j; i ++) { best = shallower(tm, best, i); }
+
+  /* whole blocks between, as two overlapping powers of two */
+  bi ++;
+  if(bi < bj) {
+    int k = 0;
+    while((2 << k) <= bj - bi) { k ++; }
+    best = shallower(tm, best, tm->sparse[k * tm->blocks + bi]);
+    best = shallower(tm, best, tm->sparse[k * tm->blocks + bj - (1 << k)]);
+  }
+
+  return tm->euler[best];
+} /* treelca() */
+
+int
+treedistance(TREEMAP *tm, int id1, int id2)
+{
+  int l;
+
+  if(!tm) { return DISTANCE_ERROR; }
+
+  l = treelca(tm, id1, id2);
+  if(l == NC) { return DISTANCE_NOPATH; }
+
+  return tm->depth[id1] + tm->depth[id2] - 2 * tm->depth[l];
+} /* treedistance() */
+
+int
+treepath(TREEMAP *tm, int id1, int id2, int *steps)
+{
+  int l, len, k;
+
+  if(!tm || !steps) { return DISTANCE_ERROR; }
+
+  l = treelca(tm, id1, id2);
+  if(l == NC) { return DISTANCE_NOPATH; }
+
+  len = tm->depth[id1] + tm->depth[id2] - 2 * tm->depth[l] + 1;
+
+  /* up from id1 to the common ancestor */
+  for(k = 0; id1 != l; k ++) {
+    steps[k] = id1;
+    id1 = tm->parent[id1];
+  }
+  steps[k] = l;
+
+  /* and up from id2, filling in from the far end */
+  for(k = len - 1; id2 != l; k --) {
+    steps[k] = id2;
+    id2 = tm->parent[id2];
+  }
+
+  return len;
+} /* treepath() */
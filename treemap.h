@@ -0,0 +1,45 @@
+/* June 2019, Benjamin Elijah Griffin / Eli the Bearded */
+/* distance oracle for perfect (tree) mazes */
+
+#ifndef _TREEMAP_H
+#define _TREEMAP_H
+
+#include "grid.h"
+#include "distance.h"
+
+/* cells per block of the Euler tour; minimums within a block are
+ * found by scanning, minimums across blocks with a sparse table.
+ */
+#define TREEMAP_BLOCK	16
+
+/* A perfect maze is a tree, so the distance between two cells is
+ * depth(a) + depth(b) - 2 * depth(lowest common ancestor).
+ * No part of this structure is intended to be changed by users.
+ */
+typedef struct {
+  GRID *grid;
+  int root_id;		/* set at creation time */
+  int msize;		/* size of per cell arrays */
+  int *depth;		/* distance from root, NV if not reachable */
+  int *parent;		/* next cell toward root, NC for root */
+  int *first;		/* first place each cell appears in euler */
+  int *euler;		/* cell ids in depth first visit order, with returns */
+  int tourlen;		/* length of euler, 2 * reachable cells - 1 */
+  int blocks;		/* number of TREEMAP_BLOCK sized blocks of euler */
+  int levels;		/* number of rows in sparse */
+  int *sparse;		/* euler index of the shallowest cell in each run
+			 * of 2^level blocks, levels rows of blocks each */
+} TREEMAP;
+
+/* NULL if the cells reachable from the root do not form a tree */
+TREEMAP *createtreemap(GRID *, CELL * /*root*/);
+void freetreemap(TREEMAP *);
+
+int treelca(TREEMAP *, int /*id1*/, int /*id2*/);
+int treedistance(TREEMAP *, int /*id1*/, int /*id2*/);
+
+/* writes the cells from id1 to id2 into steps, which needs room for
+ * treedistance() + 1 ints, and returns how many it wrote.
+ */
+int treepath(TREEMAP *, int /*id1*/, int /*id2*/, int * /*steps*/);
+#endif